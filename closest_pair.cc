@@ -24,18 +24,32 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
-#include <cfloat>
-#include <iterator>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
 #include <set>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "shuffle.h"
+#include "util.h"
+
+
+namespace shuffle = algorithms::shuffle;
+namespace util = algorithms::util;
+
 
 struct Point {
     int x;
     int y;
 
-    Point() {}
+    Point() : x(0), y(0) {}
     Point(int x, int y) : x(x), y(y) {}
 
     bool operator==(const Point& other) const {
@@ -54,37 +68,168 @@ struct Point {
 typedef std::pair<Point, Point> PointPair;
 
 
+// Returns the squared Euclidean distance between 2-d points p1 and p2, which,
+// unlike the distance itself, is exact. It doesn't overflow as long as the
+// coordinates are strictly within +/-2^30, as is assumed throughout.
+int64_t squared_distance(const Point& p1, const Point& p2) {
+    int64_t dx = int64_t(p2.x) - p1.x;
+    int64_t dy = int64_t(p2.y) - p1.y;
+    return dx * dx + dy * dy;
+}
+
+
 // Returns the Euclidean distance between 2-d points p1 and p2.
-float distance(const Point& p1, const Point& p2) {
-    return std::sqrt(std::pow(p2.x - p1.x, 2) + std::pow(p2.y - p1.y, 2));
+double distance(const Point& p1, const Point& p2) {
+    return std::sqrt(double(squared_distance(p1, p2)));
 }
 
 
-struct sort_by_x_value {
+struct sort_by_y_value {
     bool operator()(const Point& p1, const Point& p2) const {
-        return p1.x < p2.x;
+        return p1.y < p2.y;
     }
 };
 
 
-struct sort_by_y_value {
-    bool operator()(const Point& p1, const Point& p2) const {
-        return p1.y < p2.y;
+// The closest pair of points found so far, and their squared distance.
+struct ClosestPair {
+    PointPair points;
+    int64_t squared_distance;
+
+    ClosestPair() : squared_distance(INT64_MAX) {}
+
+    void consider(const Point& p1, const Point& p2) {
+        int64_t d = ::squared_distance(p1, p2);
+        if (d < squared_distance) {
+            squared_distance = d;
+            points = PointPair(p1, p2);
+        }
     }
 };
 
 
-// Comparison functor used to determine if pair1 is closer in distance than
-// pair2, for use with std::min as follows.
-struct is_closer_in_distance {
-    bool operator()(const PointPair& pair1, const PointPair& pair2) const {
-        float pair1_distance = distance(pair1.first, pair1.second);
-        float pair2_distance = distance(pair2.first, pair2.second);
-        return pair1_distance < pair2_distance;
+// Points stored as a structure of arrays, so that the x-values, or the
+// y-values, of several points can be loaded into a SIMD register at once.
+struct PointArrays {
+    std::vector<int> x;
+    std::vector<int> y;
+
+    PointArrays() {}
+    explicit PointArrays(long n) : x(n), y(n) {}
+
+    template <class InputIterator>
+    PointArrays(InputIterator first, InputIterator last) {
+        for (; first != last; first++) {
+            x.push_back(first->x);
+            y.push_back(first->y);
+        }
+    }
+
+    long size() const {
+        return x.size();
+    }
+
+    Point operator[](long i) const {
+        return Point(x[i], y[i]);
     }
 };
 
 
+// Returns the smallest squared distance from q to any of the n points
+// (xs[i], ys[i]), or INT64_MAX if n is 0.
+//
+// When compiled for AVX-512 or AVX2 (e.g. with -march=native), 16 or 8
+// squared distances are computed at a time. The coordinate differences fit
+// in 32-bit lanes, as the coordinates are strictly within +/-2^30, and are
+// squared into 64-bit lanes, whose minimum is then reduced horizontally.
+int64_t min_squared_distance(const Point& q, const int* xs, const int* ys,
+                             long n) {
+    int64_t best = INT64_MAX;
+    long i = 0;
+
+#if defined(__AVX512F__)
+    const __m512i qx16 = _mm512_set1_epi32(q.x);
+    const __m512i qy16 = _mm512_set1_epi32(q.y);
+    __m512i best16 = _mm512_set1_epi64(INT64_MAX);
+    for (; i + 16 <= n; i += 16) {
+        __m512i dx = _mm512_sub_epi32(_mm512_loadu_si512(xs + i), qx16);
+        __m512i dy = _mm512_sub_epi32(_mm512_loadu_si512(ys + i), qy16);
+
+        // _mm512_mul_epi32 multiplies the low (even) 32-bit lanes of each
+        // 64-bit lane, so the odd lanes are shifted down and done after.
+        __m512i even = _mm512_add_epi64(_mm512_mul_epi32(dx, dx),
+                                        _mm512_mul_epi32(dy, dy));
+        dx = _mm512_srli_epi64(dx, 32);
+        dy = _mm512_srli_epi64(dy, 32);
+        __m512i odd = _mm512_add_epi64(_mm512_mul_epi32(dx, dx),
+                                       _mm512_mul_epi32(dy, dy));
+        best16 = _mm512_min_epi64(best16, _mm512_min_epi64(even, odd));
+    }
+    int64_t lanes16[8];
+    _mm512_storeu_si512(lanes16, best16);
+    for (int lane = 0; lane < 8; lane++)
+        best = std::min(best, lanes16[lane]);
+#endif
+
+#if defined(__AVX2__)
+    const __m256i qx8 = _mm256_set1_epi32(q.x);
+    const __m256i qy8 = _mm256_set1_epi32(q.y);
+    __m256i best8 = _mm256_set1_epi64x(INT64_MAX);
+    for (; i + 8 <= n; i += 8) {
+        __m256i dx = _mm256_sub_epi32(
+            _mm256_loadu_si256((const __m256i*) (xs + i)), qx8);
+        __m256i dy = _mm256_sub_epi32(
+            _mm256_loadu_si256((const __m256i*) (ys + i)), qy8);
+
+        __m256i even = _mm256_add_epi64(_mm256_mul_epi32(dx, dx),
+                                        _mm256_mul_epi32(dy, dy));
+        dx = _mm256_srli_epi64(dx, 32);
+        dy = _mm256_srli_epi64(dy, 32);
+        __m256i odd = _mm256_add_epi64(_mm256_mul_epi32(dx, dx),
+                                       _mm256_mul_epi32(dy, dy));
+
+        // AVX2 has no 64-bit min, so it is made of a compare and a blend.
+        best8 = _mm256_blendv_epi8(best8, even,
+                                   _mm256_cmpgt_epi64(best8, even));
+        best8 = _mm256_blendv_epi8(best8, odd,
+                                   _mm256_cmpgt_epi64(best8, odd));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i*) lanes, best8);
+    for (int lane = 0; lane < 4; lane++)
+        best = std::min(best, lanes[lane]);
+#endif
+
+    for (; i < n; i++)
+        best = std::min(best, squared_distance(q, Point(xs[i], ys[i])));
+    return best;
+}
+
+
+// Updates `closest` with the nearest of the n points (xs[i], ys[i]) to q,
+// should it be closer.
+inline void consider_nearest(const Point& q, const int* xs, const int* ys,
+                             long n, ClosestPair& closest) {
+    if (min_squared_distance(q, xs, ys, n) >= closest.squared_distance)
+        return;
+
+    for (long i = 0; i < n; i++)
+        closest.consider(q, Point(xs[i], ys[i]));
+}
+
+
+// Updates `closest` with the closest pair of the n points (xs[i], ys[i]),
+// comparing each point with all of the points following it at once, using
+// min_squared_distance.
+void find_closest_pair_bruteforce(const int* xs, const int* ys, long n,
+                                  ClosestPair& closest) {
+    for (long i = 0; i + 1 < n; i++) {
+        consider_nearest(Point(xs[i], ys[i]), xs + i + 1, ys + i + 1,
+                         n - i - 1, closest);
+    }
+}
+
+
 // Given a pair of iterators to a collection of unique points, returns the
 // closest pair of points in range [first, last) using an O(n^2) brute-force
 // approach that compares pairwise distances for all pairs of points in [first,
@@ -92,134 +237,1375 @@ struct is_closer_in_distance {
 template <class InputIterator>
 PointPair find_closest_pair_bruteforce(InputIterator first,
                                        InputIterator last) {
-    float min_distance = FLT_MAX;
-    PointPair closest_pair;
-
-    InputIterator i, j;
-    for (i = first; i != last; i++) {
-        j = i;
-        j++;
-        for (; j != last; j++) {
-            float dist = distance(*i, *j);
-            if (dist < min_distance) {
-                min_distance = dist;
-                closest_pair.first = *i;
-                closest_pair.second = *j;
-            }
-        }
+    ClosestPair closest;
+    PointArrays points(first, last);
+    if (points.size() >= 2) {
+        find_closest_pair_bruteforce(&points.x[0], &points.y[0],
+                                     points.size(), closest);
     }
+    return closest.points;
+}
+
+
+// Subproblems of at most this many points are solved by brute force, which
+// the SIMD kernels make cheaper than dividing them further.
+const long bruteforce_cutoff = 32;
+
 
-    return closest_pair;
+// Given the strip_size points of a strip sorted by y-value, (xs[i], ys[i]),
+// compares each of the points in range [first, last) with the points
+// following it, updating `closest` with any closer pair. The following
+// points are compared a block of 8 at a time, using consider_nearest, until
+// a block ends further away in y-value alone than `closest`.
+void compare_strip(const int* xs, const int* ys, long first, long last,
+                   long strip_size, ClosestPair& closest) {
+    for (long i = first; i < last; i++) {
+        const Point p(xs[i], ys[i]);
+        for (long j = i + 1; j < strip_size; j += 8) {
+            const long block = std::min(8L, strip_size - j);
+            consider_nearest(p, xs + j, ys + j, block, closest);
+
+            int64_t dy = int64_t(ys[j + block - 1]) - p.y;
+            if (dy * dy >= closest.squared_distance)
+                break;
+        }
+    }
 }
 
 
-// Given a pair of iterators to a collection of unique points sorted by x-value
-// and y-value, Px [px_begin, px_end) and Py [py_begin, py_end) respectively,
-// and the previously calculated closest_non_split_pair of points, with
-// pairwise distance delta, returns the closest split pair of points with
-// pairwise distance less than delta. Returns closest_non_split_pair if no
-// split pair is found with pairwise distance less than delta.
+// Given n points Py [py, py + n) sorted by y-value, and x_mid, the x-value of
+// the vertical divide between the left and right halves of Py, updates
+// `closest` with any closer split pair of points.
 //
 // A split pair of points is a pair of points in which one point lies left of
-// the vertical divide x_mid, the midpoint of Px, and the other point lies to
-// the right.
-template <class RandomAccessIterator>
-PointPair find_closest_split_pair(RandomAccessIterator px_begin,
-                                  RandomAccessIterator px_end,
-                                  RandomAccessIterator py_begin,
-                                  RandomAccessIterator py_end,
-                                  const PointPair& closest_non_split_pair) {
-    Point px_mid = *(px_begin + ((px_end - px_begin) / 2));
-
-    float delta = distance(closest_non_split_pair.first,
-                           closest_non_split_pair.second);
-
-    // sy is the subset of points that lie at most delta to the left or right
-    // of the vertical divide x_mid, sorted by y-value.
-    std::vector<Point> sy;
-
-    RandomAccessIterator py_iter = py_begin;
-    for (; py_iter != py_end; py_iter++) {
-        if (std::abs(py_iter->x - px_mid.x) <= delta) {
-            sy.push_back(*py_iter);
-        }
-    }
-
-    PointPair closest_split_pair = closest_non_split_pair;
-    float min_delta = delta;
-
-
-    // For each point in sy, we need only consider at most 6 of its neighbors.
-    std::vector<Point>::iterator i, j;
-    for (i = sy.begin(); i != sy.end(); i++) {
-        for (j = i + 1; j != i + 7 && j != sy.end(); j++) {
-            float delta = distance(*i, *j);
-            if (delta < min_delta) {
-                min_delta = delta;
-                closest_split_pair.first = *i;
-                closest_split_pair.second = *j;
-            }
+// the vertical divide, and the other point lies to the right. Only points
+// closer to the divide than `closest` can be part of a closer split pair.
+// These are copied to the strip (xs[i], ys[i]), which must have room for n
+// points, and each is compared with the points following it in y-order by
+// compare_strip, until they are further away in y-value alone than
+// `closest` (at most 7 of them are any closer).
+void find_closest_split_pair(const Point* py, long n, int x_mid, int* xs,
+                             int* ys, ClosestPair& closest) {
+    long strip_size = 0;
+    for (long i = 0; i < n; i++) {
+        int64_t dx = int64_t(py[i].x) - x_mid;
+        if (dx * dx < closest.squared_distance) {
+            xs[strip_size] = py[i].x;
+            ys[strip_size] = py[i].y;
+            strip_size++;
         }
     }
 
-    return closest_split_pair;
+    compare_strip(xs, ys, 0, strip_size, strip_size, closest);
 }
 
 
-// Given a pair of iterators to a collection of unique points sorted by x-value
-// and y-value, Px [px_begin, px_end) and Py [py_begin, py_end) respectively,
-// returns the pair of points that are closest in distance using an O(nlogn)
+// Given n unique points sorted by x-value (then y-value), Px [px, px + n),
+// and the same points sorted by y-value, Py [py, py + n), updates `closest`
+// with the pair of points that are closest in distance using an O(nlogn)
 // divide-and-conquer algorithm.
-template <class RandomAccessIterator>
-PointPair find_closest_pair_rec(RandomAccessIterator px_begin,
-                                RandomAccessIterator px_end,
-                                RandomAccessIterator py_begin,
-                                RandomAccessIterator py_end) {
-    if ((px_end - px_begin < 4) || (py_end - py_begin < 4)) {
-        std::set<Point> points(px_begin, px_end);
-        std::copy(py_begin, py_end, std::inserter(points, points.begin()));
-        return find_closest_pair_bruteforce(points.begin(), points.end());
+//
+// Py is stably partitioned into the y-sorted points left and right of the
+// divide, so it need not be sorted again. The partitions are stored in
+// `scratch`, which must have room for 2n + log2(n) points, and the strips,
+// and the subproblems solved by brute force, in (xs[i], ys[i]), which must
+// have room for n points, thus nothing is allocated.
+void find_closest_pair_rec(const Point* px, long n, const Point* py,
+                           Point* scratch, int* xs, int* ys,
+                           ClosestPair& closest) {
+    if (n <= bruteforce_cutoff) {
+        for (long i = 0; i < n; i++) {
+            xs[i] = px[i].x;
+            ys[i] = px[i].y;
+        }
+        find_closest_pair_bruteforce(xs, ys, n, closest);
+        return;
     }
 
-    int middle = (px_end - px_begin) / 2;
+    const long middle = n / 2;
+    const Point& px_mid = px[middle];
 
-    PointPair closest_pair_left = find_closest_pair_rec(px_begin,
-                                                        px_begin + middle,
-                                                        py_begin,
-                                                        py_begin + middle);
+    Point* left_py = scratch;
+    Point* right_py = scratch + middle;
+    for (long i = 0, left = 0, right = 0; i < n; i++) {
+        if (py[i] < px_mid)
+            left_py[left++] = py[i];
+        else
+            right_py[right++] = py[i];
+    }
+
+    find_closest_pair_rec(px, middle, left_py, scratch + n, xs, ys, closest);
+    find_closest_pair_rec(px + middle, n - middle, right_py, scratch + n,
+                          xs, ys, closest);
+    find_closest_split_pair(py, n, px_mid.x, xs, ys, closest);
+}
 
-    PointPair closest_pair_right = find_closest_pair_rec(px_begin + middle,
-                                                         px_end, 
-                                                         py_begin + middle,
-                                                         py_end);
 
-    PointPair closest_pair = std::min(closest_pair_left, closest_pair_right,
-                                      is_closer_in_distance());
+// Given a pair of iterators to a collection of points, returns the closest
+// pair of points, and their squared distance, using an O(nlogn)
+// divide-and-conquer algorithm. See find_closest_pair_rec.
+template <class InputIterator>
+ClosestPair find_closest_pair_with_distance(InputIterator first,
+                                            InputIterator last) {
+    std::vector<Point> px(first, last);
+    std::sort(px.begin(), px.end());
+    std::vector<Point> py(px);
+    std::stable_sort(py.begin(), py.end(), sort_by_y_value());
+
+    ClosestPair closest;
+    const long n = px.size();
 
-    PointPair closest_split_pair = find_closest_split_pair(px_begin, px_end,
-                                                           py_begin, py_end,
-                                                           closest_pair);
+    // Duplicate points are the closest pair, and would break the
+    // partitioning of Py.
+    for (long i = 0; i + 1 < n; i++) {
+        if (px[i] == px[i + 1]) {
+            closest.consider(px[i], px[i + 1]);
+            return closest;
+        }
+    }
 
-    return std::min(closest_pair, closest_split_pair, is_closer_in_distance());
+    if (n >= 2) {
+        std::vector<Point> scratch(2 * n + 64);
+        PointArrays strip(n);
+        find_closest_pair_rec(&px[0], n, &py[0], &scratch[0], &strip.x[0],
+                              &strip.y[0], closest);
+    }
+    return closest;
 }
 
 
-// Given a pair of iterators to a collection of unique points, returns the pair
-// of points that are closest in distance using an O(nlogn) divide-and-conquer
+// Given a pair of iterators to a collection of points, returns the pair of
+// points that are closest in distance using an O(nlogn) divide-and-conquer
 // algorithm.
 template <class InputIterator>
 PointPair find_closest_pair(InputIterator first, InputIterator last) {
+    return find_closest_pair_with_distance(first, last).points;
+}
+
+
+// Finds the closest pair of points using Rabin's randomized grid algorithm,
+// in expected O(n) time, in the form given by Khuller and Matias.
+//
+// Points are visited in random order, and hashed into square cells with
+// sides no shorter than δ, the smallest distance seen so far, so a point can
+// only be closer than δ to points in its own cell or the 8 cells around it.
+// Whenever a point is closer than that, δ shrinks, and the points visited
+// so far are hashed again into smaller cells. Since the ith point visited
+// is one of the closest pair of the first i with probability at most 2/i,
+// rehashing costs O(n) in expectation. Cells larger than δ only hold more
+// points, so this is put off until δ has halved.
+//
+// The cells are kept in a flat open-addressing hash table of points,
+// allocated once. Entries are stamped with the generation of the grid
+// they were inserted into, so rehashing needn't clear the table.
+struct GridClosestPairFinder {
+    struct Entry {
+        Point point;
+        uint32_t generation;
+    };
+
+    std::vector<Point> points;
+    std::vector<Entry> table;
+    uint64_t mask;
+    uint32_t generation;
+    int64_t cell_size;
+    double cell_scale;
+    int64_t rehashed_squared_distance;
+    ClosestPair closest;
+
+    template <class InputIterator>
+    GridClosestPairFinder(InputIterator first, InputIterator last,
+                          uint64_t seed)
+        : points(first, last), generation(0), cell_size(0), cell_scale(0),
+          rehashed_squared_distance(0) {
+        util::Rng rng(seed);
+        shuffle::shuffle(points.begin(), points.end(), rng);
+
+        // Keep the table at most half full.
+        uint64_t capacity = 2;
+        while (capacity < 2 * points.size())
+            capacity *= 2;
+        table.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    ClosestPair find() {
+        if (points.size() < 2)
+            return closest;
+
+        closest.consider(points[0], points[1]);
+        rehash(2);
+        for (uint32_t i = 2; i < points.size(); i++) {
+            // Duplicate points can't be beaten, nor hashed into cells.
+            if (closest.squared_distance == 0)
+                break;
+
+            if (find_closer_neighbor(i) && shrunk())
+                rehash(i + 1);
+            else
+                insert(i);
+        }
+        return closest;
+    }
+
+    // Returns floor(coordinate / cell_size).
+    //
+    // Multiplying by the reciprocal is much faster than dividing, and is
+    // close enough: integer coordinates closer than δ differ by at most
+    // cell_size - 1, so they still can't be more than one cell apart.
+    int64_t cell(int coordinate) const {
+        return std::floor(coordinate * cell_scale);
+    }
+
+    uint64_t hash(int64_t cell_x, int64_t cell_y) const {
+        uint64_t h = uint64_t(cell_x) * 0x9e3779b97f4a7c15ULL
+                     ^ uint64_t(cell_y);
+        h = (h ^ (h >> 32)) * 0xd6e8feb86659fd93ULL;
+        return (h ^ (h >> 32)) & mask;
+    }
+
+    void insert(uint32_t i) {
+        const int64_t x = cell(points[i].x), y = cell(points[i].y);
+        uint64_t slot = hash(x, y);
+        while (table[slot].generation == generation)
+            slot = (slot + 1) & mask;
+        table[slot].point = points[i];
+        table[slot].generation = generation;
+    }
+
+    // Compares points[i] with the points in its own and the 8 surrounding
+    // cells, and returns whether any of them is closer than `closest`.
+    bool find_closer_neighbor(uint32_t i) {
+        const Point& p = points[i];
+        const int64_t x = cell(p.x), y = cell(p.y);
+        const int64_t before = closest.squared_distance;
+
+        for (int64_t cell_x = x - 1; cell_x <= x + 1; cell_x++) {
+            for (int64_t cell_y = y - 1; cell_y <= y + 1; cell_y++) {
+                uint64_t slot = hash(cell_x, cell_y);
+                for (; table[slot].generation == generation;
+                     slot = (slot + 1) & mask) {
+                    const Point& q = table[slot].point;
+                    if (cell(q.x) == cell_x && cell(q.y) == cell_y)
+                        closest.consider(q, p);
+                }
+            }
+        }
+        return closest.squared_distance < before;
+    }
+
+    // Returns whether δ has shrunk to less than half what it was when the
+    // grid was last rehashed.
+    bool shrunk() const {
+        return closest.squared_distance < rehashed_squared_distance / 4;
+    }
+
+    // Starts a new grid with cells of side ceil(δ), holding the first n
+    // points.
+    void rehash(uint32_t n) {
+        if (closest.squared_distance == 0)
+            return;
+
+        cell_size = std::sqrt(double(closest.squared_distance));
+        while (cell_size * cell_size < closest.squared_distance)
+            cell_size++;
+        while (cell_size > 1
+               && (cell_size - 1) * (cell_size - 1)
+                  >= closest.squared_distance)
+            cell_size--;
+
+        cell_scale = 1.0 / cell_size;
+        rehashed_squared_distance = closest.squared_distance;
+        generation++;
+        for (uint32_t i = 0; i < n; i++)
+            insert(i);
+    }
+};
+
+
+// Given a pair of iterators to a collection of points, returns the pair of
+// points that are closest in distance using Rabin's randomized grid
+// algorithm, in expected O(n) time. See GridClosestPairFinder.
+template <class InputIterator>
+PointPair find_closest_pair_grid(InputIterator first, InputIterator last,
+                                 uint64_t seed = 1) {
+    return GridClosestPairFinder(first, last, seed).find().points;
+}
+
+
+// Given sorted ranges [first1, last1) and [first2, last2), writes their
+// items to `out`, sorted, as std::merge does.
+//
+// The middle item of the larger range is found in the smaller one by binary
+// search, which splits both into a pair of ranges that can be merged
+// independently. While fewer than `threads` threads are in use, and at
+// least `grain` items remain, the first pair is merged on a new thread.
+template <typename RandomAccessIterator, typename Compare>
+void parallel_merge(RandomAccessIterator first1, RandomAccessIterator last1,
+                    RandomAccessIterator first2, RandomAccessIterator last2,
+                    RandomAccessIterator out, Compare comp, int threads,
+                    long grain) {
+    if (threads <= 1 || (last1 - first1) + (last2 - first2) < grain) {
+        std::merge(first1, last1, first2, last2, out, comp);
+        return;
+    }
+
+    // Items from the first range are placed before equal items from the
+    // second, as std::merge does.
+    RandomAccessIterator middle1, middle2;
+    if (last1 - first1 >= last2 - first2) {
+        middle1 = first1 + (last1 - first1) / 2;
+        middle2 = std::lower_bound(first2, last2, *middle1, comp);
+    }
+    else {
+        middle2 = first2 + (last2 - first2) / 2;
+        middle1 = std::upper_bound(first1, last1, *middle2, comp);
+    }
+
+    std::thread left(
+        parallel_merge<RandomAccessIterator, Compare>,
+        first1, middle1, first2, middle2, out, comp, threads / 2, grain);
+    parallel_merge(middle1, last1, middle2, last2,
+                   out + (middle1 - first1) + (middle2 - first2), comp,
+                   threads - threads / 2, grain);
+    left.join();
+}
+
+
+// Sorts the items in range [first, last) with `comp`, leaving them in
+// [first, last), or in the range of the same size starting at `buffer` if
+// `into_buffer` is set. The contents of the other range are overwritten.
+//
+// While fewer than `threads` threads are in use, and both halves hold at
+// least `grain` items, the left half is sorted on a new thread. The halves
+// are sorted into the other range, and merged back with parallel_merge.
+template <typename RandomAccessIterator, typename Compare>
+void parallel_sort(RandomAccessIterator first, RandomAccessIterator last,
+                   RandomAccessIterator buffer, bool into_buffer,
+                   Compare comp, int threads, long grain) {
+    if (threads <= 1 || last - first < 2 * grain) {
+        std::sort(first, last, comp);
+        if (into_buffer)
+            std::copy(first, last, buffer);
+        return;
+    }
+
+    const long middle = (last - first) / 2;
+    std::thread left(
+        parallel_sort<RandomAccessIterator, Compare>,
+        first, first + middle, buffer, !into_buffer, comp, threads / 2,
+        grain);
+    parallel_sort(first + middle, last, buffer + middle, !into_buffer, comp,
+                  threads - threads / 2, grain);
+    left.join();
+
+    if (into_buffer) {
+        parallel_merge(first, first + middle, first + middle, last, buffer,
+                       comp, threads, grain);
+    }
+    else {
+        RandomAccessIterator buffer_last = buffer + (last - first);
+        parallel_merge(buffer, buffer + middle, buffer + middle, buffer_last,
+                       first, comp, threads, grain);
+    }
+}
+
+
+// Updates `closest` with any closer split pair of points, as
+// find_closest_split_pair does, using `threads` threads:
+//
+//  1. Each thread counts the points closer to the divide than `closest` in
+//     its own chunk of Py.
+//  2. Each thread copies them to its own section of the strip.
+//  3. The strip is split into a chunk per thread, and each thread compares
+//     the points in its own chunk with those following them, reading on
+//     into the next chunks as far as δ allows, with compare_strip. Each
+//     thread keeps its own closest pair.
+//
+// The closest pairs found by each thread are then reduced to one.
+struct ParallelSplitPairFinder {
+    const Point* py;
+    long n;
+    int x_mid;
+    int* xs;
+    int* ys;
+    long strip_size;
+    int threads;
+    ClosestPair initial;
+
+    // offsets[t] is the position in the strip of the points from thread t's
+    // chunk of Py.
+    std::vector<long> offsets;
+    std::vector<ClosestPair> closest;
+
+    ParallelSplitPairFinder(const Point* py, long n, int x_mid, int* xs,
+                            int* ys, const ClosestPair& closest, int threads)
+        : py(py), n(n), x_mid(x_mid), xs(xs), ys(ys), strip_size(0),
+          threads(threads), initial(closest), offsets(threads + 1),
+          closest(threads, closest) {}
+
+    void operator()(ClosestPair& result) {
+        run_on_threads(&ParallelSplitPairFinder::count);
+        for (int t = 0; t < threads; t++)
+            offsets[t + 1] += offsets[t];
+        strip_size = offsets[threads];
+
+        run_on_threads(&ParallelSplitPairFinder::copy);
+        run_on_threads(&ParallelSplitPairFinder::compare);
+
+        for (int t = 0; t < threads; t++) {
+            if (closest[t].squared_distance < result.squared_distance)
+                result = closest[t];
+        }
+    }
+
+    void run_on_threads(void (ParallelSplitPairFinder::*phase)(int)) {
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.push_back(std::thread(phase, this, t));
+        (this->*phase)(0);
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+    }
+
+    bool in_strip(const Point& p) const {
+        int64_t dx = int64_t(p.x) - x_mid;
+        return dx * dx < initial.squared_distance;
+    }
+
+    void count(int t) {
+        long strip_points = 0;
+        for (long i = n * t / threads; i < n * (t + 1) / threads; i++)
+            strip_points += in_strip(py[i]);
+        offsets[t + 1] = strip_points;
+    }
+
+    void copy(int t) {
+        long out = offsets[t];
+        for (long i = n * t / threads; i < n * (t + 1) / threads; i++) {
+            if (in_strip(py[i])) {
+                xs[out] = py[i].x;
+                ys[out] = py[i].y;
+                out++;
+            }
+        }
+    }
+
+    void compare(int t) {
+        compare_strip(xs, ys, strip_size * t / threads,
+                      strip_size * (t + 1) / threads, strip_size,
+                      closest[t]);
+    }
+};
+
+
+// Given n points sorted by x-value, Px [px, px + n), updates `closest` with
+// the pair of points that are closest in distance, and writes the points
+// sorted by y-value to `py`, using `other`, also of n points, and
+// (xs[i], ys[i]), as in find_closest_pair_rec, as scratch.
+//
+// Unlike find_closest_pair_rec, Py is built by merging the y-sorted halves,
+// rather than partitioning a presorted Py, so the halves are independent:
+// each writes its Py to the other buffer, and the two buffers swap roles at
+// each level. While fewer than `threads` threads are in use, and at least
+// `grain` points remain, the left half is handled on a new thread, keeping
+// its own closest pair, and the merge and strip use all of the threads.
+void parallel_find_closest_pair_rec(const Point* px, long n, Point* py,
+                                    Point* other, int* xs, int* ys,
+                                    ClosestPair* closest, int threads,
+                                    long grain) {
+    if (n <= bruteforce_cutoff) {
+        for (long i = 0; i < n; i++) {
+            xs[i] = px[i].x;
+            ys[i] = px[i].y;
+        }
+        find_closest_pair_bruteforce(xs, ys, n, *closest);
+
+        std::copy(px, px + n, py);
+        std::sort(py, py + n, sort_by_y_value());
+        return;
+    }
+
+    const long middle = n / 2;
+    const int x_mid = px[middle].x;
+
+    if (threads > 1 && n >= grain) {
+        ClosestPair left_closest;
+        std::thread left(parallel_find_closest_pair_rec, px, middle, other,
+                         py, xs, ys, &left_closest, threads / 2, grain);
+        parallel_find_closest_pair_rec(px + middle, n - middle,
+                                       other + middle, py + middle,
+                                       xs + middle, ys + middle, closest,
+                                       threads - threads / 2, grain);
+        left.join();
+        if (left_closest.squared_distance < closest->squared_distance)
+            *closest = left_closest;
+
+        parallel_merge(other, other + middle, other + middle, other + n, py,
+                       sort_by_y_value(), threads, grain);
+        ParallelSplitPairFinder(py, n, x_mid, xs, ys, *closest,
+                                threads)(*closest);
+    }
+    else {
+        parallel_find_closest_pair_rec(px, middle, other, py, xs, ys,
+                                       closest, 1, grain);
+        parallel_find_closest_pair_rec(px + middle, n - middle,
+                                       other + middle, py + middle,
+                                       xs + middle, ys + middle, closest, 1,
+                                       grain);
+        std::merge(other, other + middle, other + middle, other + n, py,
+                   sort_by_y_value());
+        find_closest_split_pair(py, n, x_mid, xs, ys, *closest);
+    }
+}
+
+
+// Given a pair of iterators to a collection of points, returns the pair of
+// points that are closest in distance using `threads` threads. Px is sorted
+// with parallel_sort, and the divide-and-conquer recursion is done by
+// parallel_find_closest_pair_rec. Each splits work between threads until
+// fewer than `grain` points remain.
+template <class InputIterator>
+PointPair parallel_find_closest_pair(InputIterator first, InputIterator last,
+                                     int threads, long grain = 1 << 16) {
     std::vector<Point> px(first, last);
-    std::sort(px.begin(), px.end(), sort_by_x_value());
+    const long n = px.size();
+    if (n < 2)
+        return PointPair();
+
+    std::vector<Point> py(n);
+    std::vector<Point> other(n);
+    parallel_sort(px.begin(), px.end(), py.begin(), false,
+                  std::less<Point>(), threads, grain);
+
+    PointArrays strip(n);
+    ClosestPair closest;
+    parallel_find_closest_pair_rec(&px[0], n, &py[0], &other[0], &strip.x[0],
+                                   &strip.y[0], &closest, threads, grain);
+    return closest.points;
+}
+
+
+template <class InputIterator>
+PointPair parallel_find_closest_pair(InputIterator first,
+                                     InputIterator last) {
+    return parallel_find_closest_pair(
+        first, last, std::max(1u, std::thread::hardware_concurrency()));
+}
 
-    std::vector<Point> py(first, last);
-    std::sort(py.begin(), py.end(), sort_by_y_value());
 
-    return find_closest_pair_rec(px.begin(), px.end(), py.begin(), py.end());
+// Returns the coordinate of p along `axis`: 0 for x, or 1 for y.
+inline int coordinate(const Point& p, int axis) {
+    return axis == 0 ? p.x : p.y;
+}
+
+
+struct AxisLess {
+    int axis;
+
+    explicit AxisLess(int axis) : axis(axis) {}
+
+    bool operator()(const Point& p1, const Point& p2) const {
+        return coordinate(p1, axis) < coordinate(p2, axis);
+    }
+};
+
+
+// Returns the median of a, b, and c.
+inline int median(int a, int b, int c) {
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+
+// Rearranges the points in range [first, last) such that *nth is the point
+// that would be there were they sorted by their `axis` coordinate, with no
+// point before it greater, nor any point after it less, along `axis`.
+//
+// As selection::select_position does, the points are repeatedly partitioned
+// about a ninther pivot into those less than, equal to, and greater than it,
+// as quicksort::partition_section does, keeping whichever section holds
+// nth. Should that scan more than 4n points, std::nth_element finishes.
+void select_by_axis(Point* first, Point* nth, Point* last, int axis) {
+    long budget = 4 * (last - first);
+
+    while (last - first > 1) {
+        budget -= last - first;
+        if (budget < 0) {
+            std::nth_element(first, nth, last, AxisLess(axis));
+            return;
+        }
+
+        const long n = last - first;
+        int pivot = coordinate(first[n / 2], axis);
+        if (n >= 9) {
+            const long step = n / 9;
+            const Point* a = first + step / 2;
+            int medians[3];
+            for (int i = 0; i < 3; i++, a += 3 * step) {
+                medians[i] = median(coordinate(a[0], axis),
+                                    coordinate(a[step], axis),
+                                    coordinate(a[2 * step], axis));
+            }
+            pivot = median(medians[0], medians[1], medians[2]);
+        }
+
+        // Partitions [first, last) as follows:
+        //
+        //     [    <    ][   p   ][    >    ]
+        //   first       less     greater   last
+        Point* less = first;
+        Point* greater = last;
+        for (Point* i = first; i < greater; ) {
+            const int c = coordinate(*i, axis);
+            if (c < pivot)
+                std::swap(*less++, *i++);
+            else if (c > pivot)
+                std::swap(*i, *--greater);
+            else
+                i++;
+        }
+
+        if (nth < less)
+            last = less;
+        else if (nth >= greater)
+            first = greater;
+        else
+            return;
+    }
+}
+
+
+// A k-d tree over a collection of points, for answering repeated nearest
+// neighbor and range queries.
+//
+// The tree is laid out implicitly in a single array. The points in range
+// [first, last) form a subtree, split along the x axis at even depths and
+// the y axis at odd depths: the median point along that axis lies at
+// middle = first + (last - first) / 2, the points no greater than it before,
+// in its left subtree, and those no less than it after, in its right. Every
+// subtree is thus contiguous, and there are no pointers to chase. Subtrees
+// of at most `leaf_size` points are leaves, and are scanned linearly.
+//
+// The points are stored in tree order, which `points` exposes.
+struct KdTree {
+    // A point, and its squared distance from a query point.
+    typedef std::pair<int64_t, Point> Neighbor;
+
+    static const long leaf_size = 8;
+
+    std::vector<Point> points;
+
+    KdTree() {}
+
+    template <class InputIterator>
+    KdTree(InputIterator first, InputIterator last) : points(first, last) {
+        build(0, points.size(), 0);
+    }
+
+    void build(long first, long last, int axis) {
+        if (last - first <= leaf_size)
+            return;
+
+        const long middle = first + (last - first) / 2;
+        select_by_axis(&points[0] + first, &points[0] + middle,
+                       &points[0] + last, axis);
+        build(first, middle, 1 - axis);
+        build(middle + 1, last, 1 - axis);
+    }
+
+    // Writes the k points nearest `query` to `result`, nearest first. Ties
+    // in distance are broken arbitrarily.
+    void nearest(const Point& query, int k,
+                 std::vector<Neighbor>& result) const {
+        nearest_if(query, k, AllBut(-1), result);
+    }
+
+    // As `nearest`, but only considering the points at positions i for
+    // which accept(i) holds.
+    template <typename Accept>
+    void nearest_if(const Point& query, int k, Accept accept,
+                    std::vector<Neighbor>& result) const {
+        result.clear();
+        if (k > 0)
+            search(0, points.size(), 0, query, k, accept, result);
+        std::sort_heap(result.begin(), result.end());
+    }
+
+    // Writes the k points nearest each of `queries` to the corresponding
+    // element of `results`, as `nearest` does, using `threads` threads.
+    void nearest(const std::vector<Point>& queries, int k,
+                 std::vector<std::vector<Neighbor> >& results,
+                 int threads) const {
+        results.resize(queries.size());
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++) {
+            workers.push_back(std::thread(&KdTree::nearest_each, this,
+                                          &queries, k, &results, t,
+                                          threads));
+        }
+        nearest_each(&queries, k, &results, 0, threads);
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+    }
+
+    // Writes the points no further than sqrt(squared_radius) from `query`
+    // to `result`, in no particular order.
+    void within(const Point& query, int64_t squared_radius,
+                std::vector<Point>& result) const {
+        result.clear();
+        search_within(0, points.size(), 0, query, squared_radius, result);
+    }
+
+    // Returns the nearest other point to each of `points`, in the same
+    // order, using `threads` threads. A point with no other point, in a tree
+    // of one, is given itself, at distance INT64_MAX.
+    std::vector<Neighbor> all_nearest_neighbors(int threads) const {
+        std::vector<Neighbor> result(points.size());
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++) {
+            workers.push_back(std::thread(&KdTree::nearest_neighbors, this,
+                                          &result, t, threads));
+        }
+        nearest_neighbors(&result, 0, threads);
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+
+        return result;
+    }
+
+    // Returns the closest pair of points, the closest of the pairs found by
+    // all_nearest_neighbors.
+    ClosestPair closest_pair(int threads) const {
+        ClosestPair closest;
+        if (points.size() < 2)
+            return closest;
+
+        std::vector<Neighbor> neighbors = all_nearest_neighbors(threads);
+        for (size_t i = 0; i < points.size(); i++)
+            closest.consider(points[i], neighbors[i].second);
+        return closest;
+    }
+
+    // Handles every `threads`th query, starting with query t.
+    void nearest_each(const std::vector<Point>* queries, int k,
+                      std::vector<std::vector<Neighbor> >* results, int t,
+                      int threads) const {
+        for (size_t i = t; i < queries->size(); i += threads)
+            nearest((*queries)[i], k, (*results)[i]);
+    }
+
+    // Finds the nearest neighbor of each of the tth chunk of `threads`
+    // chunks of points.
+    void nearest_neighbors(std::vector<Neighbor>* result, int t,
+                           int threads) const {
+        const long n = points.size();
+        std::vector<Neighbor> heap;
+        for (long i = n * t / threads; i < n * (t + 1) / threads; i++) {
+            heap.clear();
+            search(0, n, 0, points[i], 1, AllBut(i), heap);
+            (*result)[i] = heap.empty() ? Neighbor(INT64_MAX, points[i])
+                                        : heap.front();
+        }
+    }
+
+    // Offers the point at position i to `heap`, a max-heap of the at most k
+    // nearest points to `query` found so far, if accept(i) holds. That is
+    // only checked for points near enough to be added.
+    template <typename Accept>
+    void offer(long i, const Point& query, int k, Accept accept,
+               std::vector<Neighbor>& heap) const {
+        const int64_t d = squared_distance(query, points[i]);
+        if ((int) heap.size() == k && d >= heap.front().first)
+            return;
+        if (!accept(i))
+            return;
+
+        if ((int) heap.size() < k) {
+            heap.push_back(Neighbor(d, points[i]));
+            std::push_heap(heap.begin(), heap.end());
+        }
+        else if (d < heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = Neighbor(d, points[i]);
+            std::push_heap(heap.begin(), heap.end());
+        }
+    }
+
+    // Accepts the points at every position but one.
+    struct AllBut {
+        long exclude;
+
+        explicit AllBut(long exclude) : exclude(exclude) {}
+
+        bool operator()(long i) const {
+            return i != exclude;
+        }
+    };
+
+    // Offers the points in the subtree [first, last) to `heap`, of those at
+    // positions i for which accept(i) holds. The subtree on the far side of
+    // the split from `query` is skipped if it can't hold a nearer point.
+    template <typename Accept>
+    void search(long first, long last, int axis, const Point& query, int k,
+                Accept accept, std::vector<Neighbor>& heap) const {
+        if (last - first <= leaf_size) {
+            for (long i = first; i < last; i++)
+                offer(i, query, k, accept, heap);
+            return;
+        }
+
+        const long middle = first + (last - first) / 2;
+        offer(middle, query, k, accept, heap);
+
+        const int64_t diff = int64_t(coordinate(query, axis))
+                             - coordinate(points[middle], axis);
+        long near_first = first, near_last = middle;
+        long far_first = middle + 1, far_last = last;
+        if (diff >= 0) {
+            std::swap(near_first, far_first);
+            std::swap(near_last, far_last);
+        }
+
+        search(near_first, near_last, 1 - axis, query, k, accept, heap);
+        if ((int) heap.size() < k || diff * diff < heap.front().first)
+            search(far_first, far_last, 1 - axis, query, k, accept, heap);
+    }
+
+    void search_within(long first, long last, int axis, const Point& query,
+                       int64_t squared_radius,
+                       std::vector<Point>& result) const {
+        if (last - first <= leaf_size) {
+            for (long i = first; i < last; i++) {
+                if (squared_distance(query, points[i]) <= squared_radius)
+                    result.push_back(points[i]);
+            }
+            return;
+        }
+
+        const long middle = first + (last - first) / 2;
+        if (squared_distance(query, points[middle]) <= squared_radius)
+            result.push_back(points[middle]);
+
+        const int64_t diff = int64_t(coordinate(query, axis))
+                             - coordinate(points[middle], axis);
+        if (diff <= 0 || diff * diff <= squared_radius) {
+            search_within(first, middle, 1 - axis, query, squared_radius,
+                          result);
+        }
+        if (diff >= 0 || diff * diff <= squared_radius) {
+            search_within(middle + 1, last, 1 - axis, query, squared_radius,
+                          result);
+        }
+    }
+};
+
+
+// Maintains the closest pair of a collection of points, as points are
+// inserted and erased.
+//
+// Each distinct point records a neighbor: the nearest other point at the
+// time the record was made. Inserting a point only records its own
+// neighbor, and erasing one only records new neighbors for the points whose
+// neighbor it was, yet the closest pair is always the closest of the
+// records. For any pair (a, b), whichever of a and b was recorded last,
+// while the other was present, recorded a neighbor no further away.
+//
+// Records are ordered by distance in `queue`. Nearest neighbors are found
+// with KdTrees, kept by the logarithmic method (Bentley and Saxe): level i
+// holds a tree of at most 2^i points, and an insertion rebuilds the lowest
+// levels into the first with room for them. Erased points are skipped until
+// they outnumber the present ones, when every level is rebuilt into one.
+// Insertion and nearest neighbor queries thus take O(log^2 n) amortized
+// time, and erasure takes that for each point whose neighbor was erased.
+//
+// Duplicate points are counted, and are the closest pair while any exist.
+struct DynamicClosestPair {
+    typedef KdTree::Neighbor Neighbor;
+
+    struct Record {
+        long count;
+        bool has_neighbor;
+        Neighbor neighbor;
+        // The points whose neighbor this is.
+        std::set<Point> dependents;
+
+        Record() : count(0), has_neighbor(false) {}
+    };
+
+    std::map<Point, Record> records;
+    std::set<std::pair<int64_t, Point> > queue;
+    std::set<Point> duplicates;
+    std::vector<KdTree> levels;
+    long size;
+    // The number of points in `levels`, including erased ones.
+    long indexed;
+
+    DynamicClosestPair() : size(0), indexed(0) {}
+
+    void insert(const Point& p) {
+        size++;
+        Record& record = records[p];
+        if (++record.count > 1) {
+            duplicates.insert(p);
+            return;
+        }
+
+        add_to_index(p);
+        find_neighbor(p, record);
+    }
+
+    // Erases one occurrence of p, which must be present.
+    void erase(const Point& p) {
+        std::map<Point, Record>::iterator it = records.find(p);
+        assert(it != records.end());
+        size--;
+        Record& record = it->second;
+        if (--record.count > 0) {
+            if (record.count == 1)
+                duplicates.erase(p);
+            return;
+        }
+
+        forget_neighbor(p, record);
+        std::set<Point> dependents;
+        dependents.swap(record.dependents);
+        records.erase(it);
+
+        for (std::set<Point>::iterator dependent = dependents.begin();
+             dependent != dependents.end(); dependent++) {
+            Record& dependent_record = records[*dependent];
+            queue.erase(std::make_pair(dependent_record.neighbor.first,
+                                       *dependent));
+            dependent_record.has_neighbor = false;
+            find_neighbor(*dependent, dependent_record);
+        }
+
+        if (indexed > 2 * (long) records.size() + 64)
+            rebuild_index();
+    }
+
+    // Returns the closest pair of points, or a default PointPair should
+    // there be fewer than two.
+    PointPair closest() const {
+        if (!duplicates.empty())
+            return PointPair(*duplicates.begin(), *duplicates.begin());
+        if (queue.empty())
+            return PointPair();
+
+        const Point& p = queue.begin()->second;
+        return PointPair(p, records.find(p)->second.neighbor.second);
+    }
+
+    // Accepts the points in a level that are present, other than `query`.
+    struct Present {
+        const DynamicClosestPair* owner;
+        const KdTree* tree;
+        Point query;
+
+        Present(const DynamicClosestPair* owner, const KdTree* tree,
+                const Point& query)
+            : owner(owner), tree(tree), query(query) {}
+
+        bool operator()(long i) const {
+            const Point& p = tree->points[i];
+            return !(p == query) && owner->records.count(p);
+        }
+    };
+
+    void find_neighbor(const Point& p, Record& record) {
+        // The nearest point found in each level bounds the search of the
+        // next.
+        std::vector<Neighbor> nearest;
+        for (size_t i = 0; i < levels.size(); i++) {
+            levels[i].search(0, levels[i].points.size(), 0, p, 1,
+                             Present(this, &levels[i], p), nearest);
+        }
+
+        if (!nearest.empty()) {
+            record.has_neighbor = true;
+            record.neighbor = nearest[0];
+            queue.insert(std::make_pair(record.neighbor.first, p));
+            records[record.neighbor.second].dependents.insert(p);
+        }
+    }
+
+    void forget_neighbor(const Point& p, Record& record) {
+        if (!record.has_neighbor)
+            return;
+        queue.erase(std::make_pair(record.neighbor.first, p));
+        records[record.neighbor.second].dependents.erase(p);
+        record.has_neighbor = false;
+    }
+
+    void add_to_index(const Point& p) {
+        std::vector<Point> carry(1, p);
+        for (int i = 0; ; i++) {
+            if (i == (int) levels.size())
+                levels.push_back(KdTree());
+
+            if (levels[i].points.empty() && (long) carry.size() <= (1L << i)) {
+                build_level(i, carry);
+                return;
+            }
+
+            // Erased points are left behind.
+            const std::vector<Point>& points = levels[i].points;
+            for (size_t j = 0; j < points.size(); j++) {
+                if (records.count(points[j]))
+                    carry.push_back(points[j]);
+            }
+            indexed -= points.size();
+            levels[i] = KdTree();
+        }
+    }
+
+    void rebuild_index() {
+        std::vector<Point> points;
+        for (std::map<Point, Record>::iterator it = records.begin();
+             it != records.end(); it++)
+            points.push_back(it->first);
+
+        levels.clear();
+        indexed = 0;
+        int i = 0;
+        while ((1L << i) < (long) points.size())
+            i++;
+        levels.resize(i + 1);
+        build_level(i, points);
+    }
+
+    void build_level(int i, std::vector<Point>& points) {
+        // A point erased and inserted again may be found in two levels.
+        std::sort(points.begin(), points.end());
+        points.erase(std::unique(points.begin(), points.end()),
+                     points.end());
+        indexed += points.size();
+        KdTree tree(points.begin(), points.end());
+        levels[i].points.swap(tree.points);
+    }
+};
+
+
+// Returns n unique points chosen uniformly at random from the square
+// [0, range) x [0, range).
+std::vector<Point> random_points(int n, int range, util::Rng& rng) {
+    std::vector<Point> points;
+    while ((int) points.size() < n) {
+        points.push_back(Point(rng.below(range), rng.below(range)));
+        if ((int) points.size() == n) {
+            std::sort(points.begin(), points.end());
+            points.erase(std::unique(points.begin(), points.end()),
+                         points.end());
+        }
+    }
+    shuffle::shuffle(points.begin(), points.end(), rng);
+    return points;
+}
+
+
+void test_min_squared_distance() {
+    util::Rng rng(5);
+    const int max = (1 << 30) - 1;
+
+    for (int trial = 0; trial < 1000; trial++) {
+        const int n = rng.below(50);
+        const int range = trial % 2 == 0 ? 100 : max;
+        PointArrays points(n);
+        for (int i = 0; i < n; i++) {
+            points.x[i] = int(rng.below(2 * range + 1)) - range;
+            points.y[i] = int(rng.below(2 * range + 1)) - range;
+        }
+        Point q(int(rng.below(2 * range + 1)) - range,
+                int(rng.below(2 * range + 1)) - range);
+
+        int64_t expected = INT64_MAX;
+        for (int i = 0; i < n; i++)
+            expected = std::min(expected, squared_distance(q, points[i]));
+        assert(min_squared_distance(q, points.x.data(), points.y.data(), n)
+               == expected);
+    }
+
+    // The furthest apart two points can be.
+    std::vector<Point> corners(20, Point(max, max));
+    corners[17] = Point(-max, -max);
+    PointArrays points(corners.begin(), corners.end());
+    assert(min_squared_distance(Point(-max, -max), points.x.data(),
+                                points.y.data(), 16)
+           == squared_distance(Point(-max, -max), Point(max, max)));
+}
+
+
+void test_find_closest_pair() {
+    util::Rng rng(1);
+
+    for (int trial = 0; trial < 2000; trial++) {
+        const int n = 2 + rng.below(100);
+        const int range = trial % 2 == 0 ? 1000 : 1 << 30;
+        std::vector<Point> points = random_points(n, range, rng);
+
+        PointPair expected = find_closest_pair_bruteforce(points.begin(),
+                                                          points.end());
+        ClosestPair actual = find_closest_pair_with_distance(points.begin(),
+                                                             points.end());
+        assert(actual.squared_distance
+               == squared_distance(expected.first, expected.second));
+        assert(actual.squared_distance
+               == squared_distance(actual.points.first,
+                                   actual.points.second));
+    }
+
+    // Coordinate differences whose squares overflow an int.
+    const int max = (1 << 30) - 1;
+    Point far[] = {Point(-max, 0), Point(max, 0), Point(1, max)};
+    ClosestPair closest = find_closest_pair_with_distance(far, far + 3);
+    assert(closest.squared_distance
+           == squared_distance(Point(max, 0), Point(1, max)));
+    assert(closest.squared_distance > INT32_MAX);
+
+    Point duplicates[] = {Point(0, 0), Point(5, 5), Point(9, 9), Point(5, 5)};
+    assert(find_closest_pair(duplicates, duplicates + 4)
+           == PointPair(Point(5, 5), Point(5, 5)));
+}
+
+
+void test_find_closest_pair_grid() {
+    util::Rng rng(2);
+
+    for (int trial = 0; trial < 2000; trial++) {
+        const int n = 2 + rng.below(200);
+        const int range = trial % 3 == 0 ? 100 : trial % 3 == 1 ? 100000
+                                                                : 1 << 30;
+        std::vector<Point> points = random_points(n, range, rng);
+        if (trial % 2 == 0) {
+            for (size_t i = 0; i < points.size(); i++)
+                points[i].x -= range / 2;
+        }
+
+        PointPair expected = find_closest_pair_bruteforce(points.begin(),
+                                                          points.end());
+        PointPair actual = find_closest_pair_grid(points.begin(),
+                                                  points.end(), trial);
+        assert(squared_distance(actual.first, actual.second)
+               == squared_distance(expected.first, expected.second));
+    }
+
+    Point duplicates[] = {Point(0, 0), Point(5, 5), Point(9, 9), Point(5, 5)};
+    assert(find_closest_pair_grid(duplicates, duplicates + 4)
+           == PointPair(Point(5, 5), Point(5, 5)));
+
+    Point one[] = {Point(1, 1)};
+    find_closest_pair_grid(one, one + 1);
+}
+
+
+void test_parallel_find_closest_pair() {
+    util::Rng rng(3);
+
+    for (int trial = 0; trial < 500; trial++) {
+        const int n = 2 + rng.below(2000);
+        const int range = trial % 2 == 0 ? 100 : 1 << 30;
+        std::vector<Point> points = random_points(n, range, rng);
+        // Duplicates are allowed.
+        for (int i = 0; i < 3; i++)
+            points.push_back(points[rng.below(n)]);
+        points.resize(n + rng.below(4));
+
+        int64_t expected = find_closest_pair_with_distance(
+            points.begin(), points.end()).squared_distance;
+        const int threads[] = {1, 2, 3, 8};
+        for (int t = 0; t < 4; t++) {
+            PointPair actual = parallel_find_closest_pair(
+                points.begin(), points.end(), threads[t], 16);
+            assert(squared_distance(actual.first, actual.second)
+                   == expected);
+        }
+    }
+}
+
+
+void test_kd_tree() {
+    typedef KdTree::Neighbor Neighbor;
+    util::Rng rng(4);
+
+    for (int trial = 0; trial < 300; trial++) {
+        const int n = 1 + rng.below(300);
+        const int range = trial % 2 == 0 ? 50 : 1 << 20;
+        std::vector<Point> points = random_points(n, range, rng);
+        if (trial % 3 == 0) {
+            std::vector<Point> duplicates(
+                points.begin(), points.begin() + std::min(5, n));
+            points.insert(points.end(), duplicates.begin(), duplicates.end());
+        }
+
+        KdTree tree(points.begin(), points.end());
+        assert(tree.points.size() == points.size());
+        assert(std::is_permutation(tree.points.begin(), tree.points.end(),
+                                   points.begin()));
+
+        std::vector<Point> queries;
+        for (int i = 0; i < 20; i++)
+            queries.push_back(Point(rng.below(range), rng.below(range)));
+        queries.push_back(points[0]);
+
+        const int k = 1 + rng.below(10);
+        std::vector<std::vector<Neighbor> > batch;
+        tree.nearest(queries, k, batch, 3);
+
+        for (size_t q = 0; q < queries.size(); q++) {
+            std::vector<int64_t> distances;
+            for (size_t i = 0; i < points.size(); i++)
+                distances.push_back(squared_distance(queries[q], points[i]));
+            std::sort(distances.begin(), distances.end());
+
+            std::vector<Neighbor> neighbors;
+            tree.nearest(queries[q], k, neighbors);
+            assert(neighbors == batch[q]);
+            assert(neighbors.size() == std::min<size_t>(k, points.size()));
+            for (size_t i = 0; i < neighbors.size(); i++) {
+                assert(neighbors[i].first == distances[i]);
+                assert(neighbors[i].first
+                       == squared_distance(queries[q], neighbors[i].second));
+            }
+
+            const int64_t squared_radius = distances[distances.size() / 3];
+            std::vector<Point> expected;
+            for (size_t i = 0; i < points.size(); i++) {
+                if (squared_distance(queries[q], points[i]) <= squared_radius)
+                    expected.push_back(points[i]);
+            }
+            std::vector<Point> actual;
+            tree.within(queries[q], squared_radius, actual);
+            std::sort(expected.begin(), expected.end());
+            std::sort(actual.begin(), actual.end());
+            assert(actual == expected);
+        }
+
+        std::vector<Neighbor> neighbors = tree.all_nearest_neighbors(2);
+        for (size_t i = 0; i < tree.points.size(); i++) {
+            int64_t expected = INT64_MAX;
+            for (size_t j = 0; j < tree.points.size(); j++) {
+                if (j != i) {
+                    expected = std::min(expected,
+                                        squared_distance(tree.points[i],
+                                                         tree.points[j]));
+                }
+            }
+            assert(neighbors[i].first == expected);
+        }
+
+        if (points.size() < 2)
+            continue;
+        assert(tree.closest_pair(2).squared_distance
+               == find_closest_pair_with_distance(
+                      points.begin(), points.end()).squared_distance);
+    }
+
+    // A single point has no neighbor but itself.
+    std::vector<Point> one(1, Point(3, 4));
+    KdTree tree(one.begin(), one.end());
+    std::vector<Neighbor> neighbors = tree.all_nearest_neighbors(2);
+    assert(neighbors.size() == 1);
+    assert(neighbors[0] == Neighbor(INT64_MAX, Point(3, 4)));
+    assert(tree.closest_pair(2).squared_distance == INT64_MAX);
+}
+
+
+void test_dynamic_closest_pair() {
+    util::Rng rng(6);
+
+    for (int trial = 0; trial < 40; trial++) {
+        const int range = trial % 2 == 0 ? 20 : 1 << 20;
+        DynamicClosestPair dynamic;
+        std::vector<Point> points;
+
+        for (int op = 0; op < 1000; op++) {
+            // Grow to about 100 points, then hover around that.
+            if (points.empty() || rng.below(200) >= points.size()) {
+                Point p(rng.below(range), rng.below(range));
+                if (!points.empty() && rng.below(10) == 0)
+                    p = points[rng.below(points.size())];
+                points.push_back(p);
+                dynamic.insert(p);
+            }
+            else {
+                int i = rng.below(points.size());
+                dynamic.erase(points[i]);
+                std::swap(points[i], points.back());
+                points.pop_back();
+            }
+
+            assert(dynamic.size == (long) points.size());
+            PointPair actual = dynamic.closest();
+            if (points.size() < 2) {
+                assert(actual == PointPair());
+                continue;
+            }
+
+            PointPair expected = find_closest_pair_bruteforce(points.begin(),
+                                                              points.end());
+            assert(squared_distance(actual.first, actual.second)
+                   == squared_distance(expected.first, expected.second));
+            assert(std::count(points.begin(), points.end(), actual.first));
+            assert(std::count(points.begin(), points.end(), actual.second)
+                   >= 1 + (actual.first == actual.second));
+        }
+    }
+}
+
+
+void benchmark_closest_pair(int n) {
+    util::Rng rng(1);
+    std::vector<Point> points = random_points(n, 1 << 30, rng);
+    std::cout << "n = " << n << std::endl;
+
+    util::Timer timer;
+    find_closest_pair_bruteforce(points.begin(), points.begin() + 20000);
+    std::cout << "  find_closest_pair_bruteforce (n = 20000): "
+              << timer.seconds() << " s" << std::endl;
+
+    timer = util::Timer();
+    find_closest_pair(points.begin(), points.end());
+    std::cout << "  find_closest_pair: " << timer.seconds() << " s"
+              << std::endl;
+
+    timer = util::Timer();
+    find_closest_pair_grid(points.begin(), points.end());
+    std::cout << "  find_closest_pair_grid: " << timer.seconds() << " s"
+              << std::endl;
+
+    timer = util::Timer();
+    const int threads = std::max(1u, std::thread::hardware_concurrency());
+    KdTree(points.begin(), points.end()).closest_pair(threads);
+    std::cout << "  KdTree::closest_pair: " << timer.seconds() << " s"
+              << std::endl;
+
+    timer = util::Timer();
+    DynamicClosestPair dynamic;
+    for (int i = 0; i < n / 10; i++)
+        dynamic.insert(points[i]);
+    for (int i = 0; i < n / 10; i++)
+        dynamic.erase(points[i]);
+    std::cout << "  DynamicClosestPair (" << n / 10
+              << " inserts and erases): " << timer.seconds() << " s"
+              << std::endl;
+
+    for (int threads = 1; threads <= 32; threads *= 2) {
+        timer = util::Timer();
+        parallel_find_closest_pair(points.begin(), points.end(), threads);
+        std::cout << "  parallel_find_closest_pair (" << threads
+                  << " threads): " << timer.seconds() << " s" << std::endl;
+    }
 }
 
 
 int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        benchmark_closest_pair(10000000);
+        return 0;
+    }
+
     Point tmp[] = {Point(1, 0), Point(2, 6), Point(2, 9), Point(3, 1), 
                    Point(4, 9), Point(6, 0), Point(8, 6)};
 
@@ -230,4 +1616,16 @@ int main(int argc, char** argv) {
     assert(find_closest_pair_bruteforce(points.begin(), points.end())
            == expected);
     assert(find_closest_pair(points.begin(), points.end()) == expected);
+    assert(find_closest_pair_grid(points.begin(), points.end()) == expected);
+    assert(parallel_find_closest_pair(points.begin(), points.end())
+           == expected);
+
+    test_min_squared_distance();
+    test_find_closest_pair();
+    test_find_closest_pair_grid();
+    test_parallel_find_closest_pair();
+    test_kd_tree();
+    test_dynamic_closest_pair();
+
+    std::cout << "Tests passed." << std::endl;
 }
@@ -0,0 +1,442 @@
+// Copyright (c) 2012 Gregg Gajic <gregg.gajic@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// External shuffle: shuffles files of records too large to fit in memory.
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "shuffle.h"
+#include "uniformity.h"
+#include "util.h"
+
+
+namespace shuffle = algorithms::shuffle;
+namespace uniformity = algorithms::uniformity;
+namespace util = algorithms::util;
+
+
+struct ExternalShuffleOptions {
+    // The size in bytes of each record, or 0 for newline-delimited text.
+    long record_size;
+    // The (approximate) maximum number of bytes of memory to use.
+    long memory_budget;
+    // The maximum number of temporary files to hold open at once, which
+    // should leave room under the process's limit on file descriptors.
+    int max_open_files;
+    uint64_t seed;
+
+    ExternalShuffleOptions()
+        : record_size(0), memory_budget(1L << 30), max_open_files(1000),
+          seed(0) {}
+};
+
+
+// Splits the records in `bytes` (each of `record_size` bytes, or ending in a
+// newline if record_size is 0) and appends the offset of each record's first
+// byte to `starts`. Returns the number of bytes in complete records.
+long split_records(const char* bytes, long size, long record_size,
+                   std::vector<long>& starts) {
+    if (record_size > 0) {
+        long complete = size - size % record_size;
+        for (long offset = 0; offset < complete; offset += record_size)
+            starts.push_back(offset);
+        return complete;
+    }
+
+    long offset = 0;
+    const char* newline;
+    while ((newline = static_cast<const char*>(
+                std::memchr(bytes + offset, '\n', size - offset))) != NULL) {
+        starts.push_back(offset);
+        offset = newline - bytes + 1;
+    }
+    return offset;
+}
+
+
+// Writes the records of `bytes` starting at `starts` to `output`, in a random
+// order drawn from `rng`.
+bool write_shuffled_records(const std::vector<char>& bytes,
+                            std::vector<long>& starts, long record_size,
+                            util::Rng& rng, FILE* output) {
+    shuffle::shuffle(starts.begin(), starts.end(), rng);
+    for (size_t i = 0; i < starts.size(); i++) {
+        long size = record_size;
+        if (size == 0) {
+            const char* record = &bytes[starts[i]];
+            size = static_cast<const char*>(
+                std::memchr(record, '\n', bytes.size() - starts[i]))
+                - record + 1;
+        }
+        if (std::fwrite(&bytes[starts[i]], 1, size, output) != (size_t) size)
+            return false;
+    }
+    return true;
+}
+
+
+// Appends `buffer` to `file`, and empties it.
+bool flush_bucket(std::vector<char>& buffer, FILE* file) {
+    const bool ok = buffer.empty()
+        || std::fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size();
+    buffer.clear();
+    return ok;
+}
+
+
+// Appends the records of the `input_size` bytes remaining in `input` to
+// `output` in random order, each permutation equally likely, using about
+// options.memory_budget bytes of memory. `records` is the number of records,
+// or -1 if unknown, and `open_files` the number of temporary files the
+// callers hold open.
+//
+// If the records fit in memory, they are simply read and shuffled.
+// Otherwise, two passes are made:
+//
+//  1. Input is read in large blocks, and each record is appended to one of
+//     K temporary bucket files, chosen uniformly at random, where K is
+//     chosen such that each bucket is expected to fill half the budget.
+//  2. Each bucket is read, shuffled in memory, and appended to `output`.
+//     A bucket that does not fit in memory after all is itself shuffled
+//     externally, once the memory of the first pass has been released.
+//
+// At most options.max_open_files buckets are open at once, counting those
+// of the callers, though always at least 2 per level.
+//
+// As with shuffle::BucketShuffle, the result is a uniformly random
+// permutation. Text records missing a final newline are given one.
+bool external_shuffle(FILE* input, long input_size, long records,
+                      FILE* output, const ExternalShuffleOptions& options,
+                      uint64_t seed, int open_files) {
+    const long record_size = options.record_size;
+    util::Rng rng(seed);
+
+    if (input_size == 0)
+        return true;
+
+    // A single record, however large, needs only be copied.
+    if (records == 1) {
+        std::vector<char> block(std::min(input_size, 1L << 16));
+        while (input_size > 0) {
+            size_t size = std::min<long>(block.size(), input_size);
+            if (std::fread(&block[0], 1, size, input) != size
+                || std::fwrite(&block[0], 1, size, output) != size)
+                return false;
+            input_size -= size;
+        }
+        return true;
+    }
+
+    // Allow 8 bytes per record for its offset.
+    const long min_record_size = record_size > 0 ? record_size : 2;
+    if (records < 0)
+        records = input_size / min_record_size;
+    const long memory_needed = input_size + records * 8;
+
+    if (memory_needed <= options.memory_budget) {
+        std::vector<char> bytes(input_size + 1);
+        if (std::fread(&bytes[0], 1, input_size, input) != (size_t) input_size)
+            return false;
+        bytes.resize(input_size);
+        if (record_size == 0 && bytes.back() != '\n')
+            bytes.push_back('\n');
+
+        std::vector<long> starts;
+        if (split_records(&bytes[0], bytes.size(), record_size, starts)
+            != (long) bytes.size())
+            return false;
+        return write_shuffled_records(bytes, starts, record_size, rng,
+                                      output);
+    }
+
+    const int buckets = std::max(
+        std::min<long>(2 * memory_needed / options.memory_budget + 1,
+                       options.max_open_files - open_files),
+        2L);
+    // Split the budget between the input block, and the buckets' buffers.
+    const long block_size = std::max(options.memory_budget / 2,
+                                     2 * min_record_size);
+    const long bucket_buffer_size = std::max(
+        options.memory_budget / 2 / buckets, 4096L);
+
+    // The buckets are unbuffered, and written a buffer at a time, so that
+    // the buffers can be released before the buckets are read back.
+    std::vector<FILE*> bucket_files(buckets);
+    std::vector<std::vector<char> > bucket_buffers(buckets);
+    std::vector<long> bucket_sizes(buckets);
+    std::vector<long> bucket_records(buckets);
+    for (int b = 0; b < buckets; b++) {
+        bucket_files[b] = std::tmpfile();
+        if (bucket_files[b] == NULL) {
+            for (int i = 0; i < b; i++)
+                std::fclose(bucket_files[i]);
+            return false;
+        }
+        std::setvbuf(bucket_files[b], NULL, _IONBF, 0);
+        bucket_buffers[b].reserve(bucket_buffer_size);
+    }
+
+    bool ok = true;
+    std::vector<char> block(block_size);
+    std::vector<long> starts;
+    long pending = 0;
+    long remaining = input_size;
+
+    while (ok && (remaining > 0 || pending > 0)) {
+        // A text record longer than the block needs a larger block.
+        if (pending == (long) block.size())
+            block.resize(2 * block.size());
+
+        size_t to_read = std::min<long>(block.size() - pending, remaining);
+        if (std::fread(&block[pending], 1, to_read, input) != to_read) {
+            ok = false;
+            break;
+        }
+        remaining -= to_read;
+        long filled = pending + to_read;
+        if (remaining == 0 && record_size == 0 && filled > 0
+            && block[filled - 1] != '\n') {
+            if (filled == (long) block.size())
+                block.resize(filled + 1);
+            block[filled++] = '\n';
+        }
+
+        starts.clear();
+        long complete = split_records(&block[0], filled, record_size, starts);
+        if (remaining == 0 && complete != filled) {
+            ok = false;
+            break;
+        }
+
+        for (size_t i = 0; ok && i < starts.size(); i++) {
+            const long end = i + 1 < starts.size() ? starts[i + 1] : complete;
+            const long size = end - starts[i];
+            const int b = rng.below(buckets);
+            std::vector<char>& buffer = bucket_buffers[b];
+            if ((long) buffer.size() + size > bucket_buffer_size)
+                ok = flush_bucket(buffer, bucket_files[b]);
+            if (size > bucket_buffer_size) {
+                ok = ok && std::fwrite(&block[starts[i]], 1, size,
+                                       bucket_files[b]) == (size_t) size;
+            } else {
+                buffer.insert(buffer.end(), &block[starts[i]],
+                              &block[starts[i]] + size);
+            }
+            bucket_sizes[b] += size;
+            bucket_records[b]++;
+        }
+
+        // Carry any partial record over to the next block.
+        pending = filled - complete;
+        std::memmove(&block[0], &block[complete], pending);
+    }
+    std::vector<char>().swap(block);
+    for (int b = 0; b < buckets; b++) {
+        ok = ok && flush_bucket(bucket_buffers[b], bucket_files[b]);
+        std::vector<char>().swap(bucket_buffers[b]);
+    }
+
+    // Each bucket is closed once shuffled, leaving buckets - b open.
+    for (int b = 0; b < buckets; b++) {
+        if (ok) {
+            ok = std::fseek(bucket_files[b], 0, SEEK_SET) == 0
+                 && external_shuffle(bucket_files[b], bucket_sizes[b],
+                                     bucket_records[b], output, options,
+                                     util::Rng::stream(seed, b)(),
+                                     open_files + buckets - b);
+        }
+        std::fclose(bucket_files[b]);
+    }
+
+    return ok;
+}
+
+
+// Writes the records of `input` to `output` in random order. Returns false
+// if either can't be read or written, or if the size of `input` isn't a
+// multiple of options.record_size. See above.
+bool external_shuffle(FILE* input, FILE* output,
+                      const ExternalShuffleOptions& options) {
+    if (std::fseek(input, 0, SEEK_END) != 0)
+        return false;
+    long input_size = std::ftell(input);
+    if (input_size < 0 || std::fseek(input, 0, SEEK_SET) != 0)
+        return false;
+
+    return external_shuffle(input, input_size, -1, output, options,
+                            options.seed, 0)
+           && std::fflush(output) == 0;
+}
+
+
+bool external_shuffle(const std::string& input_path,
+                      const std::string& output_path,
+                      const ExternalShuffleOptions& options) {
+    FILE* input = std::fopen(input_path.c_str(), "rb");
+    if (input == NULL)
+        return false;
+    FILE* output = std::fopen(output_path.c_str(), "wb");
+    if (output == NULL) {
+        std::fclose(input);
+        return false;
+    }
+
+    std::vector<char> input_buffer(1 << 20), output_buffer(1 << 20);
+    std::setvbuf(input, &input_buffer[0], _IOFBF, input_buffer.size());
+    std::setvbuf(output, &output_buffer[0], _IOFBF, output_buffer.size());
+
+    bool ok = external_shuffle(input, output, options);
+    ok = std::fclose(input) == 0 && ok;
+    ok = std::fclose(output) == 0 && ok;
+    return ok;
+}
+
+
+// Returns a temporary file containing `contents`, positioned at its start.
+FILE* temporary_file(const std::string& contents) {
+    FILE* file = std::tmpfile();
+    assert(file != NULL);
+    std::fwrite(contents.data(), 1, contents.size(), file);
+    std::rewind(file);
+    return file;
+}
+
+
+// Returns the contents of `file`.
+std::string read_file(FILE* file) {
+    std::string contents;
+    std::rewind(file);
+    char buffer[4096];
+    long size;
+    while ((size = std::fread(buffer, 1, sizeof buffer, file)) > 0)
+        contents.append(buffer, size);
+    return contents;
+}
+
+
+// Shuffles `contents` externally, asserts that the result contains the same
+// records, and returns it.
+std::string test_external_shuffle(const std::string& contents,
+                                  const ExternalShuffleOptions& options) {
+    FILE* input = temporary_file(contents);
+    FILE* output = std::tmpfile();
+    assert(external_shuffle(input, output, options));
+    std::string shuffled = read_file(output);
+    std::fclose(input);
+    std::fclose(output);
+
+    std::vector<std::string> expected, actual;
+    if (options.record_size == 0) {
+        expected = util::split(contents, '\n');
+        actual = util::split(shuffled, '\n');
+    }
+    else {
+        const long record_size = options.record_size;
+        for (size_t i = 0; i < contents.size(); i += record_size)
+            expected.push_back(contents.substr(i, record_size));
+        for (size_t i = 0; i < shuffled.size(); i += record_size)
+            actual.push_back(shuffled.substr(i, record_size));
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    assert(expected == actual);
+
+    return shuffled;
+}
+
+
+// Shuffles a permutation of [0, n) in range [first, last) by shuffling a
+// file of 1-byte records externally, with a memory budget so small as to
+// require 4 buckets, for use with uniformity::test_permutations.
+struct ExternalShuffleOfBytes {
+    void operator()(int* first, int* last, util::Rng& rng) const {
+        std::string contents;
+        for (int* i = first; i != last; i++)
+            contents += char('a' + *i);
+
+        ExternalShuffleOptions options;
+        options.record_size = 1;
+        options.memory_budget = 20;
+        options.seed = rng();
+        std::string shuffled = test_external_shuffle(contents, options);
+
+        for (size_t i = 0; i < shuffled.size(); i++)
+            first[i] = shuffled[i] - 'a';
+    }
+};
+
+
+int main(int argc, char** argv) {
+    ExternalShuffleOptions options;
+    options.memory_budget = 64 << 10;
+
+    // Newline-delimited text, many times larger than the memory budget.
+    std::string text;
+    for (int i = 0; i < 100000; i++)
+        text += "record " + std::to_string(i) + "\n";
+    std::string shuffled = test_external_shuffle(text, options);
+    assert(shuffled != text);
+    assert(shuffled == test_external_shuffle(text, options));
+    options.seed = 1;
+    assert(shuffled != test_external_shuffle(text, options));
+
+    // Lines longer than the memory budget, and a missing final newline.
+    std::string long_lines = std::string(100000, 'a') + "\n"
+                             + std::string(100000, 'b') + "\nc";
+    assert(test_external_shuffle(long_lines, options).size()
+           == long_lines.size() + 1);
+
+    // Fixed-size binary records.
+    options.record_size = 12;
+    std::string binary;
+    for (int i = 0; i < 50000; i++) {
+        char record[12] = {0};
+        std::memcpy(record, &i, sizeof i);
+        binary.append(record, sizeof record);
+    }
+    assert(test_external_shuffle(binary, options) != binary);
+
+    // So few files open at once that the buckets are shuffled by way of
+    // buckets of their own.
+    options.max_open_files = 4;
+    assert(test_external_shuffle(binary, options) != binary);
+
+    // Incomplete records are an error.
+    FILE* input = temporary_file(binary + "x");
+    FILE* output = std::tmpfile();
+    assert(!external_shuffle(input, output, options));
+    std::fclose(input);
+    std::fclose(output);
+
+    // Every permutation of 4 records, shuffled via 4 buckets, should appear
+    // equally often.
+    assert(uniformity::test_permutations(ExternalShuffleOfBytes(), 4, 4800,
+                                         0, 1).p_value > 0.001);
+
+    std::cout << "Tests passed." << std::endl;
+    return 0;
+}
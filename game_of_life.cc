@@ -23,10 +23,21 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <set>
+#include <string>
 #include <vector>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "util.h"
+
+
+namespace util = algorithms::util;
+
 
 struct Point {
     int x;
@@ -107,16 +118,642 @@ std::set<Point> transition(const std::set<Point>& state) {
 }
 
 
+// Returns the next state of the cells of row c, given those of the rows
+// above and below it, a and b, and of each of the three shifted a cell to
+// the west and the east, adding up the 8 neighbours of every cell at once
+// by full adders, one bit of the count to a word.
+//
+// Word may be uint64_t, or a vector type with the bitwise operators, such as
+// __m256i in GCC and Clang.
+template <typename Word>
+inline Word next_cells(Word aw, Word a, Word ae, Word w, Word c, Word e,
+                       Word bw, Word b, Word be) {
+    // The neighbours above, below and beside, each summed to two bits.
+    const Word a0 = aw ^ a ^ ae, a1 = (aw & a) | (ae & (aw ^ a));
+    const Word b0 = bw ^ b ^ be, b1 = (bw & b) | (be & (bw ^ b));
+    const Word m0 = w ^ e, m1 = w & e;
+
+    // Their total, modulo 8, whose bits are s0, s1 and s2: 8 neighbours
+    // count as none, which makes no difference to the rule.
+    const Word s0 = a0 ^ b0 ^ m0;
+    const Word carry0 = (a0 & b0) | (m0 & (a0 ^ b0));
+    const Word t = a1 ^ b1 ^ m1;
+    const Word carry1 = (a1 & b1) | (m1 & (a1 ^ b1));
+    const Word s1 = t ^ carry0, s2 = carry1 ^ (t & carry0);
+
+    // Alive with 3 neighbours, or with 2 if alive already.
+    return s1 & ~s2 & (s0 | c);
+}
+
+
+// A dense Game of Life, over a rectangle of the plane, 64 cells to a word.
+//
+// Cell (x, y) is bit (y - y0) % 64 of word (y - y0) / 64 of row x - x0.
+// Each row is padded with an empty word at either end, and the rows with an
+// empty row above and below, so that every cell's neighbours can be read
+// without bounds checks. The cells on the rectangle's edges are kept dead,
+// by growing it whenever a step brings one to life, so that the cells
+// outside, taken to be dead, could not come to life in the next step.
+//
+// When compiled for AVX2 (e.g. with -march=native), steps update 256 cells
+// at a time, and otherwise 64.
+struct BitBoard {
+    int x0, y0;
+    int rows;
+    // Words to a row, which is kept a multiple of 4.
+    int words;
+    std::vector<uint64_t> cells, next;
+
+    explicit BitBoard(const std::set<Point>& state) {
+        int min_x = 0, max_x = 0, min_y = 0, max_y = 0;
+        if (!state.empty()) {
+            min_x = state.begin()->x;
+            max_x = state.rbegin()->x;
+            min_y = max_y = state.begin()->y;
+        }
+        std::set<Point>::const_iterator it;
+        for (it = state.begin(); it != state.end(); it++) {
+            min_y = std::min(min_y, it->y);
+            max_y = std::max(max_y, it->y);
+        }
+
+        x0 = min_x - 1;
+        y0 = min_y - 1;
+        rows = max_x - min_x + 3;
+        words = (max_y - min_y + 3 + 255) / 256 * 4;
+        cells.assign((rows + 2) * stride(), 0);
+        next = cells;
+        for (it = state.begin(); it != state.end(); it++) {
+            const int y = it->y - y0;
+            row(it->x - x0)[y / 64] |= uint64_t(1) << (y % 64);
+        }
+    }
+
+    std::set<Point> points() const {
+        std::set<Point> result;
+        for (int r = 0; r < rows; r++) {
+            const uint64_t* cells_r = row(r);
+            for (int w = 0; w < words; w++) {
+                for (uint64_t bits = cells_r[w]; bits != 0;
+                        bits &= bits - 1) {
+                    result.insert(Point(x0 + r,
+                                        y0 + 64 * w + __builtin_ctzll(bits)));
+                }
+            }
+        }
+        return result;
+    }
+
+    long population() const {
+        long count = 0;
+        for (size_t i = 0; i < cells.size(); i++)
+            count += __builtin_popcountll(cells[i]);
+        return count;
+    }
+
+    void step(long generations) {
+        for (long i = 0; i < generations; i++)
+            step();
+    }
+
+    void step() {
+        for (int r = 0; r < rows; r++) {
+            const uint64_t* a = row(r - 1);
+            const uint64_t* c = row(r);
+            const uint64_t* b = row(r + 1);
+            uint64_t* out = &next[(r + 1) * stride() + 1];
+            int w = 0;
+
+#if defined(__AVX2__)
+            for (; w + 4 <= words; w += 4) {
+                const __m256i result = next_cells(
+                    west4(a + w), load4(a + w), east4(a + w),
+                    west4(c + w), load4(c + w), east4(c + w),
+                    west4(b + w), load4(b + w), east4(b + w));
+                _mm256_storeu_si256((__m256i*) (out + w), result);
+            }
+#endif
+
+            for (; w < words; w++) {
+                out[w] = next_cells(west(a + w), a[w], east(a + w),
+                                    west(c + w), c[w], east(c + w),
+                                    west(b + w), b[w], east(b + w));
+            }
+        }
+        cells.swap(next);
+
+        grow_past_live_edges();
+    }
+
+    // The word at p, each of whose cells is replaced by its west
+    // neighbour, or by its east neighbour.
+    static uint64_t west(const uint64_t* p) {
+        return p[0] << 1 | p[-1] >> 63;
+    }
+
+    static uint64_t east(const uint64_t* p) {
+        return p[0] >> 1 | p[1] << 63;
+    }
+
+#if defined(__AVX2__)
+    static __m256i load4(const uint64_t* p) {
+        return _mm256_loadu_si256((const __m256i*) p);
+    }
+
+    // As west and east, for the 4 words at p.
+    static __m256i west4(const uint64_t* p) {
+        return _mm256_or_si256(_mm256_slli_epi64(load4(p), 1),
+                               _mm256_srli_epi64(load4(p - 1), 63));
+    }
+
+    static __m256i east4(const uint64_t* p) {
+        return _mm256_or_si256(_mm256_srli_epi64(load4(p), 1),
+                               _mm256_slli_epi64(load4(p + 1), 63));
+    }
+#endif
+
+    int stride() const {
+        return words + 2;
+    }
+
+    // Returns the words of row r, for r in [-1, rows].
+    uint64_t* row(int r) {
+        return &cells[(r + 1) * stride() + 1];
+    }
+
+    const uint64_t* row(int r) const {
+        return &cells[(r + 1) * stride() + 1];
+    }
+
+    // Grows the board past each of its edges with a live cell on it, by a
+    // quarter of its longer side, so that a growing pattern grows it a
+    // number of times logarithmic in the pattern's size.
+    void grow_past_live_edges() {
+        bool top = false, bottom = false, left = false, right = false;
+        for (int w = 0; w < words; w++) {
+            top = top || row(0)[w] != 0;
+            bottom = bottom || row(rows - 1)[w] != 0;
+        }
+        for (int r = 0; r < rows; r++) {
+            left = left || (row(r)[0] & 1) != 0;
+            right = right || row(r)[words - 1] >> 63 != 0;
+        }
+        if (!(top || bottom || left || right))
+            return;
+
+        const int extra = std::max(64, std::max(rows, 64 * words) / 4);
+        const int extra_words = (extra + 255) / 256 * 4;
+        grow(top ? extra : 0, bottom ? extra : 0, left ? extra_words : 0,
+             right ? extra_words : 0);
+    }
+
+    // Adds rows above and below, and words to the left and right, keeping
+    // the number of words a multiple of 4.
+    void grow(int top, int bottom, int left, int right) {
+        const int old_rows = rows, old_words = words, old_stride = stride();
+        std::vector<uint64_t> old;
+        old.swap(cells);
+        x0 -= top;
+        y0 -= 64 * left;
+        rows += top + bottom;
+        words += left + right;
+        cells.assign((rows + 2) * stride(), 0);
+        next.assign(cells.size(), 0);
+        for (int r = 0; r < old_rows; r++) {
+            const uint64_t* old_row = &old[(r + 1) * old_stride + 1];
+            std::copy(old_row, old_row + old_words, row(r + top) + left);
+        }
+    }
+};
+
+
+// Gosper's Hashlife: the plane as a quadtree, whose nodes are hash-consed,
+// so that the same square of cells, wherever and whenever it occurs, is the
+// same node, and the future of each is worked out once.
+//
+// A node at level k is a square of 2^k cells. Its successor is its centre
+// square, of 2^(k - 1) cells, 2^j generations on, for j <= k - 2, before
+// which no cell outside the node can affect it. The successor is built
+// from those of the nine overlapping squares of 2^(k - 1) cells within the
+// node, each taken 2^(j - 1) generations on, or not at all, should j be
+// less than k - 2, and then from those of the four squares they make up.
+// Each node memoizes its successor for one j, so that a pattern that
+// repeats in space or time is stepped in time logarithmic in the number of
+// generations.
+//
+// Nodes are kept in an arena, and referred to by their index in it: nodes 0
+// and 1 are a dead and a live cell. When the arena reaches `max_bytes`, the
+// nodes unreachable from the pattern, from the empty squares, and from the
+// nodes in use by the step under way are collected, and their slots reused.
+// Successors that were collected are forgotten, which is all the cache
+// eviction there is. Should most nodes still be in use, the arena may grow
+// to twice their number before the next collection.
+//
+// See: Gosper, "Exploiting regularities in large cellular spaces" (1984).
+struct Hashlife {
+    struct Node {
+        int32_t nw, ne, sw, se;
+        // The next node in the same hash bucket, and the successor, or -1.
+        int32_t next, result;
+        // The level, or -1 for a free slot, and that the successor is
+        // 2^result_step generations on.
+        int8_t level, result_step;
+        bool marked;
+        int64_t population;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int32_t> buckets, free_nodes;
+    // The empty node at each level, and the nodes in use by a step.
+    std::vector<int32_t> empties, roots;
+    long capacity, max_nodes;
+
+    // The pattern, a node whose centre is the origin.
+    int32_t root;
+
+    explicit Hashlife(long max_bytes = 256L << 20)
+        : buckets(1 << 10, -1),
+          max_nodes(max_bytes / (sizeof(Node) + sizeof(int32_t))) {
+        capacity = max_nodes;
+        for (int alive = 0; alive < 2; alive++) {
+            Node leaf = {-1, -1, -1, -1, -1, -1, 0, 0, false, alive};
+            nodes.push_back(leaf);
+        }
+        empties.push_back(0);
+        root = empty(3);
+    }
+
+    void load(const std::set<Point>& state) {
+        int level = 3;
+        std::vector<Point> cells(state.begin(), state.end());
+        for (size_t i = 0; i < cells.size(); i++) {
+            const Point& p = cells[i];
+            while (std::max(std::max(p.x, -1 - p.x),
+                            std::max(p.y, -1 - p.y)) >> (level - 1) != 0)
+                level++;
+        }
+        const int64_t half = int64_t(1) << (level - 1);
+        root = build(level, -half, -half, cells.begin(), cells.end());
+    }
+
+    std::set<Point> points() const {
+        std::set<Point> result;
+        const int64_t half = int64_t(1) << (nodes[root].level - 1);
+        add_points(root, -half, -half, result);
+        return result;
+    }
+
+    int64_t population() const {
+        return nodes[root].population;
+    }
+
+    // Returns the state `generations` on from `state`. Successors found
+    // along the way are kept for later calls.
+    std::set<Point> advance(const std::set<Point>& state, long generations) {
+        load(state);
+        step(generations);
+        return points();
+    }
+
+    // Takes the pattern `generations` on, in steps of each power of 2 in
+    // it, first expanding it so that it can't reach the edge of its
+    // successor.
+    void step(long generations) {
+        for (int j = 0; generations >> j != 0; j++) {
+            if ((generations >> j & 1) == 0)
+                continue;
+            while (nodes[root].level < j + 3 || !centred(root))
+                root = expand(root);
+            root = successor(root, j);
+        }
+    }
+
+    // Returns whether the node's cells all lie in the square of a quarter
+    // its width, at its centre.
+    bool centred(int32_t n) {
+        const size_t mark = roots.size();
+        const int32_t inner = keep(centre(n));
+        const bool result = nodes[centre(inner)].population
+            == nodes[n].population;
+        roots.resize(mark);
+        return result;
+    }
+
+    // Returns the node twice the width of n, with n at its centre.
+    int32_t expand(int32_t n) {
+        const size_t mark = roots.size();
+        const Node& node = nodes[keep(n)];
+        const int32_t nw = node.nw, ne = node.ne, sw = node.sw, se = node.se;
+        const int32_t e = empty(node.level - 1);
+        const int32_t result = join(keep(join(e, e, e, nw)),
+                                    keep(join(e, e, ne, e)),
+                                    keep(join(e, sw, e, e)),
+                                    keep(join(se, e, e, e)));
+        roots.resize(mark);
+        return result;
+    }
+
+    int32_t successor(int32_t n, int j) {
+        const Node& node = nodes[n];
+        const int level = node.level;
+        if (node.population == 0)
+            return empty(level - 1);
+        if (node.result != -1 && node.result_step == j)
+            return node.result;
+
+        int32_t result;
+        if (level == 2) {
+            assert(j == 0);
+            result = step_4x4(n);
+        } else {
+            const size_t mark = roots.size();
+            const int32_t nw = node.nw, ne = node.ne, sw = node.sw,
+                se = node.se;
+            const int32_t squares[9] = {
+                nw, keep(horizontal(nw, ne)), ne,
+                keep(vertical(nw, sw)), keep(centre(n)),
+                keep(vertical(ne, se)),
+                sw, keep(horizontal(sw, se)), se};
+
+            const bool full = j == level - 2;
+            int32_t s[9];
+            for (int i = 0; i < 9; i++) {
+                s[i] = keep(full ? successor(squares[i], j - 1)
+                                 : centre(squares[i]));
+            }
+
+            const int k = full ? j - 1 : j;
+            const int32_t t_nw = keep(successor(
+                keep(join(s[0], s[1], s[3], s[4])), k));
+            const int32_t t_ne = keep(successor(
+                keep(join(s[1], s[2], s[4], s[5])), k));
+            const int32_t t_sw = keep(successor(
+                keep(join(s[3], s[4], s[6], s[7])), k));
+            const int32_t t_se = keep(successor(
+                keep(join(s[4], s[5], s[7], s[8])), k));
+            result = join(t_nw, t_ne, t_sw, t_se);
+            roots.resize(mark);
+        }
+
+        nodes[n].result = result;
+        nodes[n].result_step = j;
+        return result;
+    }
+
+    // Returns the centre 2 by 2 cells of a level 2 node, a generation on.
+    int32_t step_4x4(int32_t n) {
+        int cells[4][4];
+        for (int x = 0; x < 4; x++) {
+            for (int y = 0; y < 4; y++) {
+                const Node& quadrant = nodes[child(n, x / 2, y / 2)];
+                const int32_t cell = (x % 2 == 0)
+                    ? (y % 2 == 0 ? quadrant.nw : quadrant.ne)
+                    : (y % 2 == 0 ? quadrant.sw : quadrant.se);
+                cells[x][y] = cell;
+            }
+        }
+
+        int32_t next[2][2];
+        for (int x = 1; x < 3; x++) {
+            for (int y = 1; y < 3; y++) {
+                int neighbours = 0;
+                for (int i = x - 1; i <= x + 1; i++) {
+                    for (int j = y - 1; j <= y + 1; j++)
+                        neighbours += cells[i][j];
+                }
+                neighbours -= cells[x][y];
+                next[x - 1][y - 1] = neighbours == 3
+                    || (neighbours == 2 && cells[x][y] == 1);
+            }
+        }
+        return join(next[0][0], next[0][1], next[1][0], next[1][1]);
+    }
+
+    int32_t child(int32_t n, int row, int column) const {
+        const Node& node = nodes[n];
+        if (row == 0)
+            return column == 0 ? node.nw : node.ne;
+        return column == 0 ? node.sw : node.se;
+    }
+
+    // The squares of half their width at the centre of a node, between two
+    // nodes side by side, and between two nodes one above the other.
+    int32_t centre(int32_t n) {
+        const Node& node = nodes[n];
+        return join(nodes[node.nw].se, nodes[node.ne].sw, nodes[node.sw].ne,
+                    nodes[node.se].nw);
+    }
+
+    int32_t horizontal(int32_t west, int32_t east) {
+        const Node& w = nodes[west];
+        const Node& e = nodes[east];
+        return join(w.ne, e.nw, w.se, e.sw);
+    }
+
+    int32_t vertical(int32_t north, int32_t south) {
+        const Node& n = nodes[north];
+        const Node& s = nodes[south];
+        return join(n.sw, n.se, s.nw, s.ne);
+    }
+
+    int32_t empty(int level) {
+        while ((int) empties.size() <= level) {
+            const int32_t e = empties.back();
+            empties.push_back(join(e, e, e, e));
+        }
+        return empties[level];
+    }
+
+    // Returns the node of the given level, whose top left cell is (x, y),
+    // of the points in [first, last), all of which lie within it.
+    int32_t build(int level, int64_t x, int64_t y,
+                  std::vector<Point>::iterator first,
+                  std::vector<Point>::iterator last) {
+        if (first == last)
+            return empty(level);
+        if (level == 0)
+            return 1;
+
+        const int64_t half = int64_t(1) << (level - 1);
+        std::vector<Point>::iterator south = std::partition(
+            first, last, BeforeRow(x + half));
+        std::vector<Point>::iterator north_east = std::partition(
+            first, south, BeforeColumn(y + half));
+        std::vector<Point>::iterator south_east = std::partition(
+            south, last, BeforeColumn(y + half));
+
+        const size_t mark = roots.size();
+        const int32_t nw = keep(build(level - 1, x, y, first, north_east));
+        const int32_t ne = keep(build(level - 1, x, y + half, north_east,
+                                      south));
+        const int32_t sw = keep(build(level - 1, x + half, y, south,
+                                      south_east));
+        const int32_t se = keep(build(level - 1, x + half, y + half,
+                                      south_east, last));
+        const int32_t result = join(nw, ne, sw, se);
+        roots.resize(mark);
+        return result;
+    }
+
+    struct BeforeRow {
+        int64_t x;
+        explicit BeforeRow(int64_t x) : x(x) {}
+        bool operator()(const Point& p) const { return p.x < x; }
+    };
+
+    struct BeforeColumn {
+        int64_t y;
+        explicit BeforeColumn(int64_t y) : y(y) {}
+        bool operator()(const Point& p) const { return p.y < y; }
+    };
+
+    void add_points(int32_t n, int64_t x, int64_t y,
+                    std::set<Point>& result) const {
+        const Node& node = nodes[n];
+        if (node.population == 0)
+            return;
+        if (node.level == 0) {
+            result.insert(Point(x, y));
+            return;
+        }
+        const int64_t half = int64_t(1) << (node.level - 1);
+        add_points(node.nw, x, y, result);
+        add_points(node.ne, x, y + half, result);
+        add_points(node.sw, x + half, y, result);
+        add_points(node.se, x + half, y + half, result);
+    }
+
+    int32_t keep(int32_t n) {
+        roots.push_back(n);
+        return n;
+    }
+
+    // Returns the node of the four given quadrants, making it should it not
+    // exist. The quadrants must be kept, or reachable from nodes kept.
+    int32_t join(int32_t nw, int32_t ne, int32_t sw, int32_t se) {
+        for (int32_t n = buckets[hash(nw, ne, sw, se)]; n != -1;
+                n = nodes[n].next) {
+            const Node& node = nodes[n];
+            if (node.nw == nw && node.ne == ne && node.sw == sw &&
+                    node.se == se)
+                return n;
+        }
+
+        if (free_nodes.empty() && (long) nodes.size() >= capacity)
+            collect();
+        Node node = {nw, ne, sw, se, -1, -1,
+                     int8_t(nodes[nw].level + 1), 0, false,
+                     nodes[nw].population + nodes[ne].population +
+                     nodes[sw].population + nodes[se].population};
+        int32_t n;
+        if (!free_nodes.empty()) {
+            n = free_nodes.back();
+            free_nodes.pop_back();
+            nodes[n] = node;
+        } else {
+            if (nodes.size() >= buckets.size())
+                rehash(2 * buckets.size());
+            n = nodes.size();
+            nodes.push_back(node);
+        }
+        insert(n);
+        return n;
+    }
+
+    size_t hash(int32_t nw, int32_t ne, int32_t sw, int32_t se) const {
+        uint64_t h = uint32_t(nw);
+        h = h * 0x9e3779b97f4a7c15ULL + uint32_t(ne);
+        h = h * 0x9e3779b97f4a7c15ULL + uint32_t(sw);
+        h = h * 0x9e3779b97f4a7c15ULL + uint32_t(se);
+        return (h ^ h >> 29) & (buckets.size() - 1);
+    }
+
+    void insert(int32_t n) {
+        Node& node = nodes[n];
+        int32_t& bucket = buckets[hash(node.nw, node.ne, node.sw, node.se)];
+        node.next = bucket;
+        bucket = n;
+    }
+
+    void rehash(size_t size) {
+        buckets.assign(size, -1);
+        for (int32_t n = 2; n < (int32_t) nodes.size(); n++) {
+            if (nodes[n].level > 0)
+                insert(n);
+        }
+    }
+
+    void mark(int32_t n) {
+        while (!nodes[n].marked) {
+            Node& node = nodes[n];
+            node.marked = true;
+            if (node.level == 0)
+                return;
+            mark(node.nw);
+            mark(node.ne);
+            mark(node.sw);
+            n = node.se;
+        }
+    }
+
+    void collect() {
+        mark(root);
+        for (size_t i = 0; i < empties.size(); i++)
+            mark(empties[i]);
+        for (size_t i = 0; i < roots.size(); i++)
+            mark(roots[i]);
+
+        free_nodes.clear();
+        long live = 0;
+        for (int32_t n = 2; n < (int32_t) nodes.size(); n++) {
+            Node& node = nodes[n];
+            if (!node.marked) {
+                node.level = -1;
+                free_nodes.push_back(n);
+            } else {
+                live++;
+                if (node.result != -1 && !nodes[node.result].marked)
+                    node.result = -1;
+            }
+        }
+        for (int32_t n = 0; n < (int32_t) nodes.size(); n++)
+            nodes[n].marked = false;
+        rehash(buckets.size());
+        capacity = std::max(max_nodes, 2 * live);
+    }
+};
+
+
 template <class RandomAccessIterator>
 bool test_pattern(RandomAccessIterator first_state,
                   RandomAccessIterator last_state) {
+    const char* engines[] = {"transition: ", "BitBoard: ", "Hashlife: "};
     for (RandomAccessIterator i = first_state; i != last_state - 1; i++) {
-        if (transition(*i) != *(i + 1)) {
-            std::cout << "transition: " << i - first_state << " -> "
-                << i - first_state + 1 << " failed" << std::endl;
-            print_state(transition(*i));
-            std::cout << std::endl;
-            print_state(*(i + 1));
+        BitBoard board(*i);
+        board.step();
+        std::set<Point> next_states[] = {transition(*i), board.points(),
+                                         Hashlife().advance(*i, 1)};
+        for (int j = 0; j < 3; j++) {
+            if (next_states[j] != *(i + 1)) {
+                std::cout << engines[j] << i - first_state << " -> "
+                    << i - first_state + 1 << " failed" << std::endl;
+                print_state(next_states[j]);
+                std::cout << std::endl;
+                print_state(*(i + 1));
+                return false;
+            }
+        }
+    }
+
+    const long generations = last_state - first_state - 1;
+    BitBoard board(*first_state);
+    board.step(generations);
+    std::set<Point> last_states[] = {
+        board.points(), Hashlife().advance(*first_state, generations)};
+    for (int j = 0; j < 2; j++) {
+        if (last_states[j] != *(last_state - 1)) {
+            std::cout << engines[j + 1] << "0 -> " << generations
+                << " failed" << std::endl;
             return false;
         }
     }
@@ -124,7 +761,161 @@ bool test_pattern(RandomAccessIterator first_state,
 }
 
 
+// Returns a soup of random cells, alive with probability `density`, in a
+// rectangle of the given size at (x, y).
+std::set<Point> random_soup(int x, int y, int height, int width,
+                            double density, util::Rng& rng) {
+    std::set<Point> soup;
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            if (rng.uniform() < density)
+                soup.insert(Point(x + i, y + j));
+        }
+    }
+    return soup;
+}
+
+
+// Checks BitBoard against transition on random soups, as they spread out
+// across the boundaries of words and the edges of the board.
+void test_bit_board() {
+    util::Rng rng(1);
+    for (int trial = 0; trial < 20; trial++) {
+        std::set<Point> state = random_soup(
+            rng.below(200) - 100, rng.below(200) - 100, 1 + rng.below(40),
+            1 + rng.below(300), rng.uniform(), rng);
+        BitBoard board(state);
+        for (int generation = 0; generation < 40; generation++) {
+            state = transition(state);
+            board.step();
+            assert(board.points() == state);
+            assert(board.population() == (long) state.size());
+        }
+    }
+
+    assert(BitBoard(std::set<Point>()).points().empty());
+}
+
+
+// Checks Hashlife against BitBoard on random soups, stepped by random
+// numbers of generations at a time, with enough memory, and with so little
+// that it has to collect its nodes in the middle of steps.
+void test_hashlife() {
+    util::Rng rng(2);
+    for (int trial = 0; trial < 20; trial++) {
+        const std::set<Point> soup = random_soup(
+            rng.below(200) - 100, rng.below(200) - 100, 1 + rng.below(40),
+            1 + rng.below(40), rng.uniform(), rng);
+        BitBoard board(soup);
+        Hashlife life(trial % 2 == 0 ? 256L << 20 : 64L << 10);
+        life.load(soup);
+        for (int i = 0; i < 5; i++) {
+            const long generations = rng.below(i < 4 ? 20 : 300);
+            board.step(generations);
+            life.step(generations);
+            assert(life.points() == board.points());
+            assert(life.population() == board.population());
+        }
+    }
+
+    assert(Hashlife().advance(std::set<Point>(), 1000000000).empty());
+}
+
+
+// Returns the cells marked 'O' in rows of text, from (0, 0).
+std::set<Point> pattern(const char** rows, int count) {
+    std::set<Point> result;
+    for (int x = 0; x < count; x++) {
+        for (int y = 0; rows[x][y] != '\0'; y++) {
+            if (rows[x][y] == 'O')
+                result.insert(Point(x, y));
+        }
+    }
+    return result;
+}
+
+
+// Compares transition with BitBoard on a random soup of n by n cells.
+void benchmark_game_of_life(int n, int generations) {
+    util::Rng rng(1);
+    const std::set<Point> soup = random_soup(0, 0, n, n, 0.3, rng);
+
+    util::Timer timer;
+    std::set<Point> state = soup;
+    for (int i = 0; i < generations; i++)
+        state = transition(state);
+    const double set_time = timer.seconds();
+    std::cout << "n = " << n << ", " << generations << " generations: "
+              << "transition " << set_time << " s";
+
+    timer = util::Timer();
+    BitBoard board(soup);
+    board.step(generations);
+    const double board_time = timer.seconds();
+    std::cout << ", BitBoard " << board_time << " s" << std::endl;
+    assert(board.points() == state);
+
+    // Many more generations, to show the cost of a step once it is dense.
+    const int more = 100 * generations;
+    timer = util::Timer();
+    board.step(more);
+    const double seconds = timer.seconds();
+    std::cout << "  BitBoard, " << more << " more generations: " << seconds
+              << " s, " << (double) board.rows * board.words * 64 * more
+                 / seconds / 1e9
+              << " billion cell updates/s, " << board.population()
+              << " cells alive" << std::endl;
+}
+
+
+// Compares BitBoard with Hashlife on Gosper's glider gun, whose population
+// grows by a glider every 30 generations, and with Hashlife alone over
+// `generations`.
+void benchmark_hashlife(long generations) {
+    const char* rows[] = {
+        "........................O...........",
+        "......................O.O...........",
+        "............OO......OO............OO",
+        "...........O...O....OO............OO",
+        "OO........O.....O...OO..............",
+        "OO........O...O.OO....O.O...........",
+        "..........O.....O.......O...........",
+        "...........O...O....................",
+        "............OO......................"};
+    const std::set<Point> gun = pattern(rows, 9);
+
+    const long few = 10000;
+    util::Timer timer;
+    BitBoard board(gun);
+    board.step(few);
+    const double board_time = timer.seconds();
+
+    timer = util::Timer();
+    Hashlife life;
+    life.load(gun);
+    life.step(few);
+    std::cout << "Glider gun, " << few << " generations: BitBoard "
+              << board_time << " s, Hashlife " << timer.seconds() << " s"
+              << std::endl;
+    assert(life.population() == board.population());
+
+    timer = util::Timer();
+    life.load(gun);
+    life.step(generations);
+    std::cout << "  Hashlife, " << generations << " generations: "
+              << timer.seconds() << " s, " << life.population()
+              << " cells alive, " << life.nodes.size() << " nodes"
+              << std::endl;
+}
+
+
 int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        benchmark_game_of_life(256, 20);
+        benchmark_hashlife(1000000000);
+        return 0;
+    }
+
     typedef std::set<Point> State;
 
     // Still lifes
@@ -259,6 +1050,7 @@ int main(int argc, char** argv) {
         pulsar.push_back(State(s3, s3 + (sizeof s3 / sizeof s3[0])));
         pulsar.push_back(pulsar[0]);
         assert(test_pattern(pulsar.begin(), pulsar.end()));
+        assert(Hashlife().advance(pulsar[0], 3000000000L) == pulsar[0]);
     }
 
 
@@ -281,7 +1073,16 @@ int main(int argc, char** argv) {
         glider.push_back(State(s4, s4 + 5));
         glider.push_back(State(s5, s5 + 5));
         assert(test_pattern(glider.begin(), glider.end()));
+
+        // A billion generations on, it has moved 250 million cells
+        // diagonally.
+        State far;
+        for (int i = 0; i < 5; i++)
+            far.insert(Point(s1[i].x + 250000000, s1[i].y + 250000000));
+        assert(Hashlife().advance(glider[0], 1000000000) == far);
     }
 
+    test_bit_board();
+    test_hashlife();
     std::cout << "Tests passed." << std::endl;
 }
@@ -0,0 +1,256 @@
+// Copyright (c) 2012 Gregg Gajic <gregg.gajic@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Graphs in CSR form: parsing, and binary images.
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "graph.h"
+#include "util.h"
+
+
+namespace graph = algorithms::graph;
+namespace util = algorithms::util;
+
+
+// An arc's target and weight.
+typedef std::pair<int, int64_t> Arc;
+
+
+// Returns the arcs leaving v.
+std::vector<Arc> arcs(const graph::Graph& g, int v) {
+    std::vector<Arc> result;
+    for (int64_t a = g.offsets[v]; a < g.offsets[v + 1]; a++)
+        result.push_back(Arc(g.targets[a], g.weight(a)));
+    return result;
+}
+
+
+std::vector<Arc> make_arcs(int count, const int* targets,
+                           const int64_t* weights) {
+    std::vector<Arc> result;
+    for (int i = 0; i < count; i++)
+        result.push_back(Arc(targets[i], weights != NULL ? weights[i] : 1));
+    return result;
+}
+
+
+bool same_graph(const graph::Graph& g1, const graph::Graph& g2) {
+    if (g1.n != g2.n || g1.weighted() != g2.weighted())
+        return false;
+    for (int v = 0; v < g1.n; v++) {
+        if (arcs(g1, v) != arcs(g2, v))
+            return false;
+    }
+    return true;
+}
+
+
+// Returns the path of a new temporary file containing `contents`.
+std::string temporary_file(const std::string& contents) {
+    char path[] = "/tmp/graph_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    long written = write(fd, contents.data(), contents.size());
+    assert(written == (long) contents.size());
+    close(fd);
+    return path;
+}
+
+
+void test_parse() {
+    graph::ParseOptions options;
+    graph::Graph g;
+
+    // A directed, weighted edge list, with comments and blank lines.
+    assert(graph::parse("# u v weight\n0 1 5\n\n0 2 -3\r\n  2 1 7",
+                        options, graph::EdgeList(), g));
+    assert(g.n == 3 && g.arcs() == 3 && g.weighted());
+    const int targets0[] = {1, 2};
+    const int64_t weights0[] = {5, -3};
+    assert(arcs(g, 0) == make_arcs(2, targets0, weights0));
+    assert(arcs(g, 1).empty());
+    const int targets2[] = {1};
+    const int64_t weights2[] = {7};
+    assert(arcs(g, 2) == make_arcs(1, targets2, weights2));
+
+    // Undirected, numbered from 1.
+    options.undirected = true;
+    options.base = 1;
+    assert(graph::parse("% a comment\n1 2\n2 3\n3 3\n", options,
+                        graph::EdgeList(), g));
+    assert(g.n == 3 && g.arcs() == 5 && !g.weighted());
+    const int targets[] = {1, 0, 2, 1, 2};
+    assert(arcs(g, 1) == make_arcs(2, targets + 1, NULL));
+    assert(arcs(g, 2) == make_arcs(2, targets + 3, NULL));
+
+    // An adjacency list, with an isolated vertex, and weights.
+    options = graph::ParseOptions();
+    assert(graph::parse("0 1 2\n3\n1 0\n2 0\n", options,
+                        graph::AdjacencyList(), g));
+    assert(g.n == 4 && g.arcs() == 4 && !g.weighted());
+    assert(g.degree(0) == 2 && g.degree(3) == 0);
+
+    assert(graph::parse("0 1,4 2,6\n1 0,4\n", options,
+                        graph::AdjacencyList(), g));
+    assert(g.n == 3 && g.weighted());
+    const int targets_w[] = {1, 2};
+    const int64_t weights_w[] = {4, 6};
+    assert(arcs(g, 0) == make_arcs(2, targets_w, weights_w));
+
+    // Nothing to parse.
+    assert(graph::parse("", options, graph::EdgeList(), g));
+    assert(g.n == 0 && g.arcs() == 0);
+
+    // Malformed text.
+    const char* malformed[] = {"0\n", "0 x\n", "0 1 2 3\n", "-1 0\n",
+                               "0 99999999999999999999\n", "0 1 ,\n"};
+    for (int i = 0; i < 6; i++)
+        assert(!graph::parse(malformed[i], options, graph::EdgeList(), g));
+    assert(!graph::parse("0 1,\n", options, graph::AdjacencyList(), g));
+    assert(!graph::parse("0 1, 2\n", options, graph::AdjacencyList(), g));
+    options.base = 1;
+    assert(!graph::parse("0 1\n", options, graph::EdgeList(), g));
+}
+
+
+void test_load_and_save() {
+    util::Rng rng(1);
+    for (int weighted = 0; weighted < 2; weighted++) {
+        for (int m = 0; m < 40; m += 7) {
+            std::ostringstream text;
+            for (int e = 0; e < m; e++) {
+                text << rng.below(10) << " " << rng.below(10);
+                if (weighted)
+                    text << " " << rng.below(100);
+                text << "\n";
+            }
+
+            graph::Graph parsed;
+            assert(graph::parse(text.str(), graph::ParseOptions(),
+                                graph::EdgeList(), parsed));
+
+            std::string text_path = temporary_file(text.str());
+            graph::Graph loaded;
+            assert(graph::load(text_path, graph::ParseOptions(),
+                               graph::EdgeList(), loaded));
+            assert(same_graph(loaded, parsed));
+
+            std::string image_path = temporary_file("");
+            assert(graph::save(parsed, image_path));
+            graph::Graph image;
+            assert(graph::load_image(image_path, image));
+            assert(same_graph(image, parsed));
+
+            // The image outlives the copy it was loaded into.
+            graph::Graph copy = image;
+            image = graph::Graph();
+            assert(same_graph(copy, parsed));
+
+            std::remove(text_path.c_str());
+            std::remove(image_path.c_str());
+        }
+    }
+
+    graph::Graph g;
+    assert(!graph::load("/nonexistent", graph::ParseOptions(),
+                        graph::EdgeList(), g));
+    std::string path = temporary_file("CSRGRAPH but truncated");
+    assert(!graph::load_image(path, g));
+    std::remove(path.c_str());
+}
+
+
+// Compares parsing a random edge list with tokenizing it by util::split and
+// std::stringstream, as mincut.cc's adjacency lists are, and loading the
+// same graph from a binary image.
+void benchmark_graph(int n, long m) {
+    util::Rng rng(1);
+    std::string text;
+    for (long e = 0; e < m; e++) {
+        std::ostringstream line;
+        line << rng.below(n) << " " << rng.below(n) << "\n";
+        text += line.str();
+    }
+    std::string path = temporary_file(text);
+    std::cout << "n = " << n << ", m = " << m << ", "
+              << text.size() / 1e6 << " MB" << std::endl;
+
+    util::Timer timer;
+    std::vector<std::string> lines = util::split(text, '\n');
+    std::vector<std::pair<int, int> > edges;
+    for (size_t e = 0; e < lines.size(); e++) {
+        std::vector<std::string> tokens = util::split(lines[e], ' ');
+        int u, v;
+        std::stringstream(tokens[0]) >> u;
+        std::stringstream(tokens[1]) >> v;
+        edges.push_back(std::make_pair(u, v));
+    }
+    std::cout << "  split and stringstream: " << timer.seconds() << " s"
+              << std::endl;
+
+    timer = util::Timer();
+    graph::Graph g;
+    bool ok = graph::load(path, graph::ParseOptions(), graph::EdgeList(), g);
+    assert(ok);
+    std::cout << "  load (mmap, two passes): " << timer.seconds() << " s"
+              << std::endl;
+
+    std::string image_path = temporary_file("");
+    timer = util::Timer();
+    ok = graph::save(g, image_path);
+    assert(ok);
+    std::cout << "  save image: " << timer.seconds() << " s" << std::endl;
+
+    timer = util::Timer();
+    graph::Graph image;
+    ok = graph::load_image(image_path, image);
+    assert(ok);
+    int64_t sum = 0;
+    for (int64_t a = 0; a < image.arcs(); a++)
+        sum += image.targets[a];
+    std::cout << "  load image, and read every arc: " << timer.seconds()
+              << " s" << std::endl;
+    assert(image.arcs() == m && sum >= 0);
+
+    std::remove(path.c_str());
+    std::remove(image_path.c_str());
+}
+
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        benchmark_graph(1000000, 10000000);
+        return 0;
+    }
+
+    test_parse();
+    test_load_and_save();
+    std::cout << "Tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,516 @@
+// Copyright (c) 2012 Gregg Gajic <gregg.gajic@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Graphs in compressed sparse row (CSR) form, parsed from adjacency-list or
+// edge-list text, or loaded from a binary image without copying.
+
+#ifndef ALGORITHMS_GRAPH_H
+#define ALGORITHMS_GRAPH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace algorithms {
+namespace graph {
+
+// A file mapped read-only into memory, and unmapped on destruction.
+struct MappedFile {
+    const char* data;
+    long size;
+
+    MappedFile() : data(NULL), size(0) {}
+
+    ~MappedFile() {
+        close();
+    }
+
+    // Maps the file at `path`. Returns false if it can't be opened or
+    // mapped.
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size = st.st_size;
+        if (size == 0) {
+            data = "";
+            ::close(fd);
+            return true;
+        }
+
+        void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            size = 0;
+            return false;
+        }
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+        return true;
+    }
+
+    void close() {
+        if (size > 0)
+            munmap(const_cast<char*>(data), size);
+        data = NULL;
+        size = 0;
+    }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+
+// A directed graph over vertices 0, 1, ..., n - 1, in CSR form: the arcs
+// leaving vertex v lead to targets[offsets[v], offsets[v + 1]), and weigh
+// the same range of `weights`, which is NULL for an unweighted graph. An
+// undirected graph has an arc each way for each edge.
+//
+// The arrays are immutable, and shared by copies of the graph; `storage`
+// owns them, be they in vectors or a MappedFile.
+struct Graph {
+    int n;
+    const int64_t* offsets;
+    const int32_t* targets;
+    const int64_t* weights;
+    std::shared_ptr<const void> storage;
+
+    Graph() : n(0), offsets(no_arcs()), targets(NULL), weights(NULL) {}
+
+    // The number of arcs.
+    int64_t arcs() const {
+        return offsets[n];
+    }
+
+    int64_t degree(int v) const {
+        return offsets[v + 1] - offsets[v];
+    }
+
+    bool weighted() const {
+        return weights != NULL;
+    }
+
+    // The weight of arc a, which is 1 in an unweighted graph.
+    int64_t weight(int64_t a) const {
+        return weights != NULL ? weights[a] : 1;
+    }
+
+    static const int64_t* no_arcs() {
+        static const int64_t zero = 0;
+        return &zero;
+    }
+};
+
+
+// The arrays of a Graph built in memory.
+struct GraphArrays {
+    std::vector<int64_t> offsets;
+    std::vector<int32_t> targets;
+    std::vector<int64_t> weights;
+};
+
+
+// Returns a graph over the given arrays, which it takes, leaving `arrays`
+// empty. An empty `weights` makes the graph unweighted.
+Graph make_graph(GraphArrays& arrays) {
+    std::shared_ptr<GraphArrays> owned = std::make_shared<GraphArrays>();
+    owned->offsets.swap(arrays.offsets);
+    owned->targets.swap(arrays.targets);
+    owned->weights.swap(arrays.weights);
+
+    Graph graph;
+    if (owned->offsets.empty())
+        return graph;
+    graph.n = owned->offsets.size() - 1;
+    graph.offsets = &owned->offsets[0];
+    graph.targets = owned->targets.empty() ? NULL : &owned->targets[0];
+    if (!owned->weights.empty())
+        graph.weights = &owned->weights[0];
+    graph.storage = owned;
+    return graph;
+}
+
+
+struct ParseOptions {
+    // Whether each edge also gives an arc in the opposite direction.
+    bool undirected;
+    // The number of the first vertex, e.g. 1 for a file numbered from 1.
+    int base;
+
+    ParseOptions() : undirected(false), base(0) {}
+};
+
+
+// Reads integers from text, a line at a time, without copying it or
+// consulting the locale. Lines starting with '#' or '%' are comments.
+struct Scanner {
+    const char* p;
+    const char* end;
+
+    Scanner(const char* first, const char* last) : p(first), end(last) {}
+
+    void skip_blanks() {
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+    }
+
+    // Skips blanks, returning whether the line has ended.
+    bool at_line_end() {
+        skip_blanks();
+        return p == end || *p == '\n';
+    }
+
+    // Moves past the end of the current line.
+    void next_line() {
+        const char* newline =
+            static_cast<const char*>(std::memchr(p, '\n', end - p));
+        p = newline != NULL ? newline + 1 : end;
+    }
+
+    // Skips blank lines and comments, returning false at the end of the
+    // text.
+    bool next_record() {
+        for (;;) {
+            if (at_line_end()) {
+                if (p == end)
+                    return false;
+                p++;
+            } else if (*p == '#' || *p == '%') {
+                next_line();
+            } else {
+                return true;
+            }
+        }
+    }
+
+    // Reads an integer, optionally signed, that fits an int64_t.
+    bool read(int64_t& value) {
+        skip_blanks();
+        return read(p, value);
+    }
+
+    // Reads an integer starting exactly at `from`.
+    bool read(const char* from, int64_t& value) {
+        p = from;
+        bool negative = p != end && *p == '-';
+        if (negative)
+            p++;
+        if (p == end || *p < '0' || *p > '9')
+            return false;
+
+        uint64_t magnitude = 0;
+        for (; p != end && *p >= '0' && *p <= '9'; p++) {
+            if (magnitude > (INT64_MAX - 9) / 10)
+                return false;
+            magnitude = magnitude * 10 + (*p - '0');
+        }
+        value = negative ? -(int64_t)magnitude : magnitude;
+        return true;
+    }
+
+    // Reads a vertex, numbered from `base`, as a number from 0.
+    bool read_vertex(int base, int32_t& v) {
+        int64_t value;
+        if (!read(value) || value < base || value - base > INT32_MAX - 1)
+            return false;
+        v = value - base;
+        return true;
+    }
+};
+
+
+// The first of the two passes of a parse: counts the arcs leaving each
+// vertex, in offsets[v + 1], and notes whether any arc has a weight.
+struct CountArcs {
+    std::vector<int64_t>& offsets;
+    bool weighted;
+
+    explicit CountArcs(std::vector<int64_t>& offsets)
+        : offsets(offsets), weighted(false) {}
+
+    void vertex(int32_t v) {
+        if (v + 2 > (long) offsets.size())
+            offsets.resize(v + 2, 0);
+    }
+
+    void arc(int32_t u, int32_t v, int64_t weight, bool has_weight) {
+        vertex(std::max(u, v));
+        offsets[u + 1]++;
+        weighted |= has_weight;
+    }
+};
+
+
+// The second pass: writes each arc after those already written from the
+// same vertex, next[u] being the position of the next arc from u.
+struct PlaceArcs {
+    std::vector<int64_t>& next;
+    GraphArrays& arrays;
+
+    PlaceArcs(std::vector<int64_t>& next, GraphArrays& arrays)
+        : next(next), arrays(arrays) {}
+
+    void vertex(int32_t v) {}
+
+    void arc(int32_t u, int32_t v, int64_t weight, bool has_weight) {
+        int64_t a = next[u]++;
+        arrays.targets[a] = v;
+        if (!arrays.weights.empty())
+            arrays.weights[a] = weight;
+    }
+};
+
+
+// Scans an edge list, of lines of "u v" or "u v weight", calling
+// visit.arc(u, v, weight, has_weight) for each arc. Returns false on
+// malformed text.
+template <typename Visit>
+bool scan_edge_list(const char* first, const char* last,
+                    const ParseOptions& options, Visit& visit) {
+    Scanner scanner(first, last);
+    while (scanner.next_record()) {
+        int32_t u, v;
+        int64_t weight = 1;
+        if (!scanner.read_vertex(options.base, u)
+                || !scanner.read_vertex(options.base, v))
+            return false;
+        bool has_weight = !scanner.at_line_end();
+        if (has_weight && (!scanner.read(weight) || !scanner.at_line_end()))
+            return false;
+
+        visit.arc(u, v, weight, has_weight);
+        if (options.undirected && u != v)
+            visit.arc(v, u, weight, has_weight);
+    }
+    return true;
+}
+
+
+// Scans an adjacency list, of lines of a vertex followed by its neighbors,
+// each optionally followed by a comma and the weight of the edge to it,
+// e.g. "1 2,7 3,5", calling visit.vertex(u) for each line and
+// visit.arc(u, v, weight, has_weight) for each arc. Returns false on
+// malformed text.
+template <typename Visit>
+bool scan_adjacency_list(const char* first, const char* last,
+                         const ParseOptions& options, Visit& visit) {
+    Scanner scanner(first, last);
+    while (scanner.next_record()) {
+        int32_t u;
+        if (!scanner.read_vertex(options.base, u))
+            return false;
+        visit.vertex(u);
+
+        while (!scanner.at_line_end()) {
+            int32_t v;
+            int64_t weight = 1;
+            if (!scanner.read_vertex(options.base, v))
+                return false;
+            bool has_weight = scanner.p != scanner.end && *scanner.p == ',';
+            if (has_weight && !scanner.read(++scanner.p, weight))
+                return false;
+
+            visit.arc(u, v, weight, has_weight);
+            if (options.undirected && u != v)
+                visit.arc(v, u, weight, has_weight);
+        }
+    }
+    return true;
+}
+
+
+// The text formats, each scanning text as the function it's named after.
+struct EdgeList {
+    template <typename Visit>
+    bool operator()(const char* first, const char* last,
+                    const ParseOptions& options, Visit& visit) const {
+        return scan_edge_list(first, last, options, visit);
+    }
+};
+
+
+struct AdjacencyList {
+    template <typename Visit>
+    bool operator()(const char* first, const char* last,
+                    const ParseOptions& options, Visit& visit) const {
+        return scan_adjacency_list(first, last, options, visit);
+    }
+};
+
+
+// Parses text in the given format into `graph`, over vertices up to the
+// largest numbered, in two passes: one counting the arcs leaving each
+// vertex, and thus their offsets, and one placing them. Arcs leaving a
+// vertex keep their order in the text. Returns false on malformed text.
+template <typename Format>
+bool parse(const char* first, const char* last, const ParseOptions& options,
+           Format format, Graph& graph) {
+    GraphArrays arrays;
+    CountArcs count(arrays.offsets);
+    if (!format(first, last, options, count))
+        return false;
+    if (arrays.offsets.empty())
+        arrays.offsets.push_back(0);
+
+    const int n = arrays.offsets.size() - 1;
+    for (int v = 0; v < n; v++)
+        arrays.offsets[v + 1] += arrays.offsets[v];
+    arrays.targets.resize(arrays.offsets[n]);
+    if (count.weighted)
+        arrays.weights.resize(arrays.offsets[n]);
+
+    std::vector<int64_t> next(arrays.offsets.begin(), arrays.offsets.end());
+    PlaceArcs place(next, arrays);
+    format(first, last, options, place);
+
+    graph = make_graph(arrays);
+    return true;
+}
+
+
+template <typename Format>
+bool parse(const std::string& text, const ParseOptions& options,
+           Format format, Graph& graph) {
+    return parse(text.data(), text.data() + text.size(), options, format,
+                 graph);
+}
+
+
+// Parses the file at `path`, mapped into memory. Returns false if it can't
+// be read, or is malformed.
+template <typename Format>
+bool load(const std::string& path, const ParseOptions& options,
+          Format format, Graph& graph) {
+    MappedFile file;
+    return file.open(path)
+           && parse(file.data, file.data + file.size, options, format, graph);
+}
+
+
+// The header of a binary image of a graph, which is followed by its
+// offsets, its targets, padding to a multiple of 8 bytes, and its weights,
+// if any, in the machine's byte order.
+struct ImageHeader {
+    char magic[8];
+    int64_t n;
+    int64_t arcs;
+    int64_t weighted;
+};
+
+const char image_magic[8] = {'C', 'S', 'R', 'G', 'R', 'A', 'P', 'H'};
+
+
+// Writes `count` items of `size` bytes from `data`, which may be NULL if
+// there are none.
+bool write_items(const void* data, size_t size, int64_t count, FILE* file) {
+    return count == 0
+        || std::fwrite(data, size, count, file) == (size_t) count;
+}
+
+
+// Writes a binary image of `graph` to `path`. Returns false if it can't be
+// written.
+bool save(const Graph& graph, const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    ImageHeader header;
+    std::memcpy(header.magic, image_magic, sizeof header.magic);
+    header.n = graph.n;
+    header.arcs = graph.arcs();
+    header.weighted = graph.weighted();
+
+    const int64_t padding[1] = {0};
+    const long padding_size = (header.arcs % 2) * sizeof(int32_t);
+    bool ok = std::fwrite(&header, sizeof header, 1, file) == 1
+        && write_items(graph.offsets, sizeof(int64_t), graph.n + 1, file)
+        && write_items(graph.targets, sizeof(int32_t), header.arcs, file)
+        && write_items(padding, 1, padding_size, file);
+    if (ok && graph.weighted())
+        ok = write_items(graph.weights, sizeof(int64_t), header.arcs, file);
+    return std::fclose(file) == 0 && ok;
+}
+
+
+// Maps a binary image written by `save`, and points `graph` into it,
+// without copying or validating the arrays, which remain mapped for as long
+// as any copy of the graph exists. Returns false if the file can't be
+// mapped, or isn't an image of the size its header implies.
+bool load_image(const std::string& path, Graph& graph) {
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(path) || file->size < (long) sizeof(ImageHeader))
+        return false;
+
+    ImageHeader header;
+    std::memcpy(&header, file->data, sizeof header);
+    if (std::memcmp(header.magic, image_magic, sizeof header.magic) != 0
+            || header.n < 0 || header.n > INT32_MAX - 1
+            || header.arcs < 0 || header.arcs > file->size)
+        return false;
+
+    const long offsets_at = sizeof header;
+    const long targets_at = offsets_at + (header.n + 1) * sizeof(int64_t);
+    const long weights_at = targets_at
+        + (header.arcs + header.arcs % 2) * sizeof(int32_t);
+    const long size = weights_at
+        + (header.weighted ? header.arcs * sizeof(int64_t) : 0);
+    if (file->size != size)
+        return false;
+
+    const int64_t* offsets =
+        reinterpret_cast<const int64_t*>(file->data + offsets_at);
+    if (offsets[0] != 0 || offsets[header.n] != header.arcs)
+        return false;
+
+    graph = Graph();
+    graph.n = header.n;
+    graph.offsets = offsets;
+    graph.targets = reinterpret_cast<const int32_t*>(file->data + targets_at);
+    if (header.weighted) {
+        graph.weights =
+            reinterpret_cast<const int64_t*>(file->data + weights_at);
+    }
+    graph.storage = file;
+    return true;
+}
+
+}  // namespace graph
+}  // namespace algorithms
+
+#endif  // ALGORITHMS_GRAPH_H
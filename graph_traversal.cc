@@ -0,0 +1,778 @@
+// Copyright (c) 2012 Gregg Gajic <gregg.gajic@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Graph traversal: BFS, DFS, connected components, strongly connected
+// components, topological sort.
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "graph.h"
+#include "graph_traversal.h"
+#include "shuffle.h"
+#include "util.h"
+
+
+namespace graph = algorithms::graph;
+namespace shuffle = algorithms::shuffle;
+namespace util = algorithms::util;
+
+
+// Returns the graph of an adjacency list, of lines of a vertex followed by
+// the heads of the arcs from it.
+graph::Graph adjacency_list(const std::string& text) {
+    graph::Graph result;
+    bool ok = graph::parse(text, graph::ParseOptions(),
+                           graph::AdjacencyList(), result);
+    assert(ok);
+    return result;
+}
+
+
+// Returns the graph of n vertices and `arcs`, built directly in CSR form.
+graph::Graph csr_graph(int n,
+                       const std::vector<std::pair<int32_t, int32_t> >& arcs) {
+    graph::GraphArrays arrays;
+    arrays.offsets.assign(n + 1, 0);
+    for (size_t a = 0; a < arcs.size(); a++)
+        arrays.offsets[arcs[a].first + 1]++;
+    for (int v = 0; v < n; v++)
+        arrays.offsets[v + 1] += arrays.offsets[v];
+    arrays.targets.resize(arcs.size());
+    std::vector<int64_t> next(arrays.offsets.begin(), arrays.offsets.end());
+    for (size_t a = 0; a < arcs.size(); a++)
+        arrays.targets[next[arcs[a].first]++] = arcs[a].second;
+    return graph::make_graph(arrays);
+}
+
+
+// Returns a graph of n vertices and m random arcs, or edges, should it be
+// undirected.
+graph::Graph random_graph(int n, long m, bool undirected, util::Rng& rng) {
+    std::vector<std::pair<int32_t, int32_t> > arcs;
+    for (long e = 0; e < m; e++) {
+        int u = rng.below(n), v = rng.below(n);
+        arcs.push_back(std::make_pair(u, v));
+        if (undirected && u != v)
+            arcs.push_back(std::make_pair(v, u));
+    }
+    return csr_graph(n, arcs);
+}
+
+
+// Returns an undirected R-MAT graph of 2^scale vertices and
+// edge_factor * 2^scale edges, less self-loops, as in the Graph 500
+// benchmark: each edge falls in one of the quadrants of the adjacency
+// matrix with probabilities 0.57, 0.19, 0.19 and 0.05, recursively. The
+// vertices are then shuffled, so that their degrees don't follow their
+// numbers.
+//
+// See: Chakrabarti, Zhan and Faloutsos, "R-MAT: A recursive model for graph
+// mining" (2004).
+graph::Graph rmat_graph(int scale, int edge_factor, util::Rng& rng) {
+    const int n = 1 << scale;
+    std::vector<int32_t> label(n);
+    for (int v = 0; v < n; v++)
+        label[v] = v;
+    shuffle::shuffle(label.begin(), label.end(), rng);
+
+    std::vector<std::pair<int32_t, int32_t> > arcs;
+    arcs.reserve(2L * edge_factor * n);
+    for (long e = 0; e < (long)edge_factor * n; e++) {
+        int u = 0, v = 0;
+        for (int bit = 0; bit < scale; bit++) {
+            double r = rng.uniform();
+            u = 2 * u + (r >= 0.76);
+            v = 2 * v + (r >= 0.57 && r < 0.76) + (r >= 0.95);
+        }
+        if (u != v) {
+            arcs.push_back(std::make_pair(label[u], label[v]));
+            arcs.push_back(std::make_pair(label[v], label[u]));
+        }
+    }
+    return csr_graph(n, arcs);
+}
+
+
+std::vector<int32_t> sorted(std::vector<int32_t> vertices) {
+    std::sort(vertices.begin(), vertices.end());
+    return vertices;
+}
+
+
+// Returns the vertices of each component, each sorted, in sorted order.
+std::vector<std::vector<int32_t> > groups(
+        const std::vector<int32_t>& component, int components) {
+    std::vector<std::vector<int32_t> > result(components);
+    for (size_t v = 0; v < component.size(); v++)
+        result[component[v]].push_back(v);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+
+// The vertices reached by a BFS and a DFS from `source`.
+std::vector<int32_t> bfs(const graph::Graph& g, int source) {
+    graph::Traversal traversal(g);
+    std::vector<int32_t> order;
+    traversal.bfs(source, order);
+    return order;
+}
+
+
+std::vector<int32_t> dfs_postorder(const graph::Graph& g, int source) {
+    graph::Traversal traversal(g);
+    std::vector<int32_t> preorder, postorder;
+    traversal.dfs(source, preorder, postorder);
+    assert(sorted(preorder) == sorted(postorder));
+    return postorder;
+}
+
+
+// The examples of graph_traversal.py, with vertices numbered in the
+// order of their names.
+void test_examples() {
+    // a b c d e f g s
+    graph::Graph g = adjacency_list("0 2 7\n1 3 7\n2 0 4\n3 1 4\n4 2 3\n"
+                                    "5 6\n6 5\n7 0 1\n");
+    const int first[] = {0, 1, 2, 3, 4, 7}, second[] = {5, 6};
+    std::vector<int32_t> component1(first, first + 6);
+    std::vector<int32_t> component2(second, second + 2);
+    assert(sorted(bfs(g, 7)) == component1);
+    assert(sorted(bfs(g, 5)) == component2);
+    assert(bfs(g, 7)[0] == 7 && bfs(g, 7).size() == 6);
+    assert(sorted(dfs_postorder(g, 7)) == component1);
+    assert(dfs_postorder(g, 7).back() == 7);
+
+    std::vector<int32_t> component;
+    assert(graph::connected_components(g, component) == 2);
+    std::vector<std::vector<int32_t> > components = groups(component, 2);
+    assert(components[0] == component1 && components[1] == component2);
+
+    // s t v w
+    g = adjacency_list("0 2 3\n1\n2 1\n3 1\n");
+    std::vector<int32_t> order;
+    assert(graph::topological_sort(g, order));
+    const int swvt[] = {0, 3, 2, 1};
+    assert(order == std::vector<int32_t>(swvt, swvt + 4));
+    assert(graph::strongly_connected_components(g, component) == 4);
+
+    // a b c d e f g h i j k
+    g = adjacency_list("0 1\n1 2 7\n2 3 5\n3 4\n4 5\n5 3\n6 5 8 10\n"
+                       "7 0 6 9\n8 4 10\n9 6\n10 9\n");
+    assert(graph::strongly_connected_components(g, component) == 4);
+    components = groups(component, 4);
+    const int abh[] = {0, 1, 7}, c[] = {2}, def[] = {3, 4, 5};
+    const int gijk[] = {6, 8, 9, 10};
+    assert(components[0] == std::vector<int32_t>(abh, abh + 3));
+    assert(components[1] == std::vector<int32_t>(c, c + 1));
+    assert(components[2] == std::vector<int32_t>(def, def + 3));
+    assert(components[3] == std::vector<int32_t>(gijk, gijk + 4));
+    assert(!graph::topological_sort(g, order));
+
+    // Vertices 0, 1, 4 and 6 are absent from the example.
+    g = adjacency_list("2\n3 8 10\n5 11\n7 8 11\n8 9\n9\n10\n11 2 9\n");
+    assert(graph::topological_sort(g, order));
+    std::vector<int32_t> present;
+    for (size_t i = 0; i < order.size(); i++) {
+        int v = order[i];
+        if (v != 0 && v != 1 && v != 4 && v != 6)
+            present.push_back(v);
+    }
+    const int expected[] = {7, 5, 11, 3, 10, 8, 9, 2};
+    assert(present == std::vector<int32_t>(expected, expected + 8));
+
+    // s t v w, weighted.
+    g = adjacency_list("0 2,1 3,4\n1\n2 3,2 1,6\n3 1,3\n");
+    std::vector<int64_t> distance;
+    graph::shortest_paths(g, 0, distance);
+    const int64_t stvw[] = {0, 6, 1, 3};
+    assert(distance == std::vector<int64_t>(stvw, stvw + 4));
+    graph::shortest_paths(g, 3, distance);
+    assert(distance[0] == graph::no_path && distance[1] == 3);
+}
+
+
+// Checks the results on random graphs against their definitions.
+void test_random_graphs() {
+    util::Rng rng(1);
+    for (int trial = 0; trial < 200; trial++) {
+        const int n = 1 + rng.below(100);
+        graph::Graph g = random_graph(n, rng.below(3 * n), false, rng);
+
+        // Vertices are in the same strongly connected component exactly
+        // when each reaches the other.
+        std::vector<int32_t> component;
+        int components = graph::strongly_connected_components(g, component);
+        std::vector<std::vector<char> > reaches(n, std::vector<char>(n));
+        for (int u = 0; u < n; u++) {
+            std::vector<int32_t> reached = bfs(g, u);
+            assert(sorted(reached) == sorted(dfs_postorder(g, u)));
+            for (size_t i = 0; i < reached.size(); i++)
+                reaches[u][reached[i]] = true;
+        }
+        for (int u = 0; u < n; u++) {
+            assert(component[u] >= 0 && component[u] < components);
+            for (int v = 0; v < n; v++) {
+                assert((component[u] == component[v])
+                       == (reaches[u][v] && reaches[v][u]));
+            }
+            for (int64_t a = g.offsets[u]; a < g.offsets[u + 1]; a++)
+                assert(component[g.targets[a]] <= component[u]);
+        }
+
+        // The graph is acyclic exactly when every component is a single
+        // vertex without a self-loop.
+        bool acyclic = components == n;
+        for (int u = 0; u < n; u++) {
+            for (int64_t a = g.offsets[u]; a < g.offsets[u + 1]; a++)
+                acyclic &= g.targets[a] != u;
+        }
+        std::vector<int32_t> order;
+        assert(graph::topological_sort(g, order) == acyclic);
+        assert((int) sorted(order).size() == n);
+
+        // Vertices are in the same connected component exactly when the
+        // BFS from either reaches the other.
+        g = random_graph(n, rng.below(n), true, rng);
+        components = graph::connected_components(g, component);
+        for (int u = 0; u < n; u++) {
+            std::vector<int32_t> reached = bfs(g, u);
+            for (size_t i = 0; i < reached.size(); i++)
+                assert(component[reached[i]] == component[u]);
+            assert((long) reached.size()
+                   == std::count(component.begin(), component.end(),
+                                 component[u]));
+        }
+    }
+}
+
+
+// Returns the depth of each vertex from `source`, or -1 if unreached.
+std::vector<int32_t> bfs_depths(const graph::Graph& g, int source) {
+    std::vector<int32_t> order = bfs(g, source), depth(g.n, -1);
+    depth[source] = 0;
+    for (size_t i = 0; i < order.size(); i++) {
+        const int u = order[i];
+        for (int64_t a = g.offsets[u]; a < g.offsets[u + 1]; a++) {
+            if (depth[g.targets[a]] < 0)
+                depth[g.targets[a]] = depth[u] + 1;
+        }
+    }
+    return depth;
+}
+
+
+void test_parallel_traversal() {
+    util::Rng rng(3);
+    for (int trial = 0; trial < 100; trial++) {
+        graph::Graph g;
+        if (trial % 4 == 0) {
+            g = rmat_graph(1 + rng.below(10), 1 + rng.below(8), rng);
+        } else {
+            const int n = 1 + rng.below(3000);
+            g = random_graph(n, rng.below(3 * n), true, rng);
+        }
+        const int source = rng.below(g.n);
+        const std::vector<int32_t> depth = bfs_depths(g, source);
+        std::vector<int32_t> component;
+        const int components = graph::connected_components(g, component);
+
+        for (int threads = 1; threads <= 4; threads++) {
+            // By default; top-down only; and going bottom-up at once, and
+            // staying there.
+            for (int i = 0; i < 3; i++) {
+                graph::ParallelBfs parallel_bfs(g, threads);
+                if (i > 0)
+                    parallel_bfs.alpha = i == 1 ? 0 : 1 << 30;
+                if (i == 2)
+                    parallel_bfs.beta = 1 << 30;
+                std::vector<int32_t> parallel_depth;
+                parallel_bfs.run(source, parallel_depth);
+                assert(parallel_depth == depth);
+            }
+
+            std::vector<int32_t> parallel_component;
+            assert(graph::parallel_connected_components(
+                       g, parallel_component, threads) == components);
+            assert(parallel_component == component);
+        }
+    }
+}
+
+
+// Returns g with random weights in [min_weight, max_weight] on its arcs.
+graph::Graph with_weights(const graph::Graph& g, int64_t min_weight,
+                          int64_t max_weight, util::Rng& rng) {
+    graph::GraphArrays arrays;
+    arrays.offsets.assign(g.offsets, g.offsets + g.n + 1);
+    arrays.targets.assign(g.targets, g.targets + g.arcs());
+    arrays.weights.resize(g.arcs());
+    for (int64_t a = 0; a < g.arcs(); a++)
+        arrays.weights[a] =
+            min_weight + rng.below(max_weight - min_weight + 1);
+    return graph::make_graph(arrays);
+}
+
+
+// Returns the distances from source, by Dijkstra's algorithm over a
+// std::priority_queue.
+std::vector<int64_t> heap_dijkstra(const graph::Graph& g, int source) {
+    typedef std::pair<int64_t, int32_t> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > heap;
+    std::vector<int64_t> distance(g.n, graph::no_path);
+    distance[source] = 0;
+    heap.push(Entry(0, source));
+    while (!heap.empty()) {
+        Entry entry = heap.top();
+        heap.pop();
+        const int u = entry.second;
+        if (entry.first > distance[u])
+            continue;
+        for (int64_t a = g.offsets[u]; a < g.offsets[u + 1]; a++) {
+            const int v = g.targets[a];
+            if (distance[u] + g.weight(a) < distance[v]) {
+                distance[v] = distance[u] + g.weight(a);
+                heap.push(Entry(distance[v], v));
+            }
+        }
+    }
+    return distance;
+}
+
+
+void test_shortest_paths() {
+    graph::RadixHeap heap;
+    const uint64_t keys[] = {5, 9, 5, 6, 1000, 7, 7, 1 << 20};
+    for (int i = 0; i < 8; i++)
+        heap.push(keys[i], i);
+    uint64_t last = 0;
+    for (int i = 0; i < 8; i++) {
+        graph::RadixHeap::Entry entry = heap.pop();
+        assert(entry.first >= last && entry.first == keys[entry.second]);
+        last = entry.first;
+        // Keys may go in as low as the last popped.
+        if (i == 2)
+            heap.push(6, 3);
+    }
+    assert(heap.pop() == graph::RadixHeap::Entry(1 << 20, 7));
+    assert(heap.empty());
+
+    util::Rng rng(4);
+    for (int trial = 0; trial < 100; trial++) {
+        graph::Graph g;
+        if (trial % 4 == 0) {
+            g = rmat_graph(1 + rng.below(10), 1 + rng.below(8), rng);
+        } else {
+            const int n = 1 + rng.below(2000);
+            g = random_graph(n, rng.below(4 * n), trial % 2, rng);
+        }
+        const int64_t max_weight = trial % 3 == 0 ? 1 : 1 + rng.below(1000);
+        g = with_weights(g, 0, max_weight, rng);
+
+        std::vector<int32_t> sources;
+        std::vector<std::vector<int64_t> > expected;
+        for (int i = rng.below(5); i >= 0; i--) {
+            sources.push_back(rng.below(g.n));
+            expected.push_back(heap_dijkstra(g, sources.back()));
+        }
+
+        // One engine for every source.
+        graph::Dijkstra dijkstra(g);
+        for (size_t i = 0; i < sources.size(); i++) {
+            dijkstra.run(sources[i]);
+            assert(dijkstra.distance == expected[i]);
+        }
+
+        for (int threads = 1; threads <= 4; threads++) {
+            std::vector<std::vector<int64_t> > distances;
+            graph::shortest_paths(g, sources, distances, threads);
+            assert(distances == expected);
+
+            const int64_t delta = 1 + rng.below(2 * max_weight);
+            std::vector<int64_t> distance;
+            graph::parallel_shortest_paths(g, sources[0], delta, distance,
+                                           threads);
+            assert(distance == expected[0]);
+
+            // A window of few bins, often moved past the overflow.
+            graph::DeltaStepping stepping(g, threads, delta);
+            stepping.window = 1 + rng.below(4);
+            stepping.run(sources[0], distance);
+            assert(distance == expected[0]);
+        }
+    }
+}
+
+
+// Formats vertices as the script of test_against_python prints them.
+std::string format(const std::vector<int32_t>& vertices) {
+    std::ostringstream out;
+    for (size_t i = 0; i < vertices.size(); i++)
+        out << (i > 0 ? " " : "") << vertices[i];
+    return out.str();
+}
+
+
+std::string format(const std::vector<std::vector<int32_t> >& groups) {
+    std::string out;
+    for (size_t i = 0; i < groups.size(); i++)
+        out += (i > 0 ? "|" : "") + format(groups[i]);
+    return out;
+}
+
+
+// Returns the graph as a Python dict of lists.
+std::string python_dict(const graph::Graph& g) {
+    std::ostringstream out;
+    out << "{";
+    for (int u = 0; u < g.n; u++) {
+        out << u << ": [";
+        for (int64_t a = g.offsets[u]; a < g.offsets[u + 1]; a++)
+            out << (a > g.offsets[u] ? ", " : "") << g.targets[a];
+        out << "], ";
+    }
+    out << "}";
+    return out.str();
+}
+
+
+// Returns the weighted graph as a Python dict of lists of pairs of target
+// and weight.
+std::string python_weighted_dict(const graph::Graph& g) {
+    std::ostringstream out;
+    out << "{";
+    for (int u = 0; u < g.n; u++) {
+        out << u << ": [";
+        for (int64_t a = g.offsets[u]; a < g.offsets[u + 1]; a++) {
+            out << (a > g.offsets[u] ? ", " : "") << "(" << g.targets[a]
+                << ", " << g.weight(a) << ")";
+        }
+        out << "], ";
+    }
+    out << "}";
+    return out.str();
+}
+
+
+// Runs graph_traversal.py on random graphs, and checks that each function
+// gives the same results as its counterpart. A directed graph's vertices
+// each have an arc, as strongly_connected_components in Python fails on
+// isolated vertices.
+void test_against_python() {
+    const std::string source = __FILE__;
+    const std::string directory = source.find('/') == std::string::npos
+        ? "." : source.substr(0, source.rfind('/'));
+
+    util::Rng rng(2);
+    std::ostringstream script;
+    script << "import sys\nsys.path.insert(0, '" << directory << "')\n"
+           << "from graph_traversal import *\n"
+           << "def line(vertices):\n"
+           << "    print(' '.join(str(v) for v in vertices))\n"
+           << "def distances(distance):\n"
+           << "    print(' '.join('%d:%d' % (v, distance[v])\n"
+           << "                   for v in sorted(distance)))\n"
+           << "def groups(components):\n"
+           << "    print('|'.join(' '.join(str(v) for v in c) for c in\n"
+           << "                   sorted(sorted(c) for c in components)))\n";
+
+    std::vector<std::string> expected;
+    for (int trial = 0; trial < 100; trial++) {
+        const int n = 1 + rng.below(60);
+        std::ostringstream text;
+        for (int u = 0; u < n; u++) {
+            text << u;
+            for (int i = rng.below(4); i >= 0; i--)
+                text << " " << rng.below(n);
+            text << "\n";
+        }
+        graph::Graph digraph = adjacency_list(text.str());
+        graph::Graph undirected;
+        graph::ParseOptions options;
+        options.undirected = true;
+        std::ostringstream edges;
+        for (int u = 0; u < n; u++) {
+            for (int64_t a = digraph.offsets[u]; a < digraph.offsets[u + 1];
+                    a++)
+                edges << u << " " << digraph.targets[a] << "\n";
+        }
+        bool ok = graph::parse(edges.str(), options, graph::EdgeList(),
+                               undirected);
+        assert(ok);
+
+        // A DAG, its vertices shuffled.
+        std::vector<int32_t> label(n);
+        for (int v = 0; v < n; v++)
+            label[v] = v;
+        shuffle::shuffle(label.begin(), label.end(), rng);
+        std::ostringstream dag_text;
+        for (int u = 0; u < n; u++) {
+            dag_text << label[u];
+            for (int i = rng.below(4); i > 0 && u + 1 < n; i--)
+                dag_text << " " << label[u + 1 + rng.below(n - u - 1)];
+            dag_text << "\n";
+        }
+        graph::Graph dag = adjacency_list(dag_text.str());
+        graph::Graph weighted = with_weights(digraph, 0, 20, rng);
+
+        script << "d = " << python_dict(digraph) << "\n"
+               << "u = " << python_dict(undirected) << "\n"
+               << "dag = " << python_dict(dag) << "\n"
+               << "line(sorted(BFS(d, 0)))\n"
+               << "line(sorted(iterative_DFS(d, 0)))\n"
+               << "line(DFS(d, 0)[1])\n"
+               << "groups(connected_components(u))\n"
+               << "groups(strongly_connected_components(d))\n"
+               << "line(topological_sort(dag))\n"
+               << "distances(dijkstra_shortest_path("
+               << python_weighted_dict(weighted) << ", 0))\n";
+
+        std::vector<int32_t> component, order;
+        expected.push_back(format(sorted(bfs(digraph, 0))));
+        expected.push_back(format(sorted(dfs_postorder(digraph, 0))));
+        expected.push_back(format(dfs_postorder(digraph, 0)));
+        int components = graph::connected_components(undirected, component);
+        expected.push_back(format(groups(component, components)));
+        components = graph::strongly_connected_components(digraph, component);
+        expected.push_back(format(groups(component, components)));
+        assert(graph::topological_sort(dag, order));
+        expected.push_back(format(order));
+        std::vector<int64_t> distance;
+        graph::shortest_paths(weighted, 0, distance);
+        std::ostringstream reached;
+        for (int v = 0; v < n; v++) {
+            if (distance[v] != graph::no_path)
+                reached << (reached.tellp() > 0 ? " " : "") << v << ":"
+                        << distance[v];
+        }
+        expected.push_back(reached.str());
+    }
+
+    char path[] = "/tmp/graph_traversal_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    std::string text = script.str();
+    long written = write(fd, text.data(), text.size());
+    assert(written == (long) text.size());
+    close(fd);
+
+    std::string command = "python3 " + std::string(path) + " 2>/dev/null";
+    FILE* python = popen(command.c_str(), "r");
+    std::vector<std::string> lines;
+    if (python != NULL) {
+        char buffer[1 << 16];
+        while (std::fgets(buffer, sizeof buffer, python) != NULL) {
+            std::string line = buffer;
+            lines.push_back(line.substr(0, line.size() - 1));
+        }
+        pclose(python);
+    }
+    std::remove(path);
+
+    if (lines.empty()) {
+        std::cout << "Skipped the tests against graph_traversal.py, which "
+                  << "python3 couldn't run." << std::endl;
+        return;
+    }
+    assert(lines == expected);
+}
+
+
+// Times each traversal of a random graph of n vertices and m arcs or edges.
+void benchmark_graph_traversal(int n, long m) {
+    util::Rng rng(1);
+    graph::Graph digraph = random_graph(n, m, false, rng);
+    graph::Graph undirected = random_graph(n, m, true, rng);
+    std::cout << "n = " << n << ", m = " << m << std::endl;
+
+    util::Timer timer;
+    std::vector<int32_t> order;
+    order.reserve(n);
+    graph::Traversal traversal(undirected);
+    traversal.bfs(0, order);
+    std::cout << "  BFS: " << timer.seconds() << " s, " << order.size()
+              << " vertices reached" << std::endl;
+
+    timer = util::Timer();
+    std::vector<int32_t> preorder, postorder;
+    preorder.reserve(n);
+    postorder.reserve(n);
+    traversal.reset();
+    traversal.dfs(0, preorder, postorder);
+    std::cout << "  DFS: " << timer.seconds() << " s" << std::endl;
+
+    timer = util::Timer();
+    std::vector<int32_t> component;
+    int components = graph::connected_components(undirected, component);
+    std::cout << "  connected components: " << timer.seconds() << " s, "
+              << components << " components" << std::endl;
+
+    timer = util::Timer();
+    components = graph::strongly_connected_components(digraph, component);
+    std::cout << "  strongly connected components: " << timer.seconds()
+              << " s, " << components << " components" << std::endl;
+
+    timer = util::Timer();
+    bool acyclic = graph::topological_sort(digraph, order);
+    std::cout << "  topological sort: " << timer.seconds() << " s"
+              << (acyclic ? "" : " (found a cycle)") << std::endl;
+}
+
+
+// Compares the sequential and parallel BFS and connected components on an
+// R-MAT graph, on 1, 2, 4, ... threads, up to the hardware's.
+void benchmark_parallel_traversal(int scale) {
+    util::Rng rng(1);
+    graph::Graph g = rmat_graph(scale, 16, rng);
+    int source = 0;
+    for (int v = 0; v < g.n; v++) {
+        if (g.degree(v) > g.degree(source))
+            source = v;
+    }
+    std::cout << "R-MAT, scale " << scale << ": n = " << g.n << ", "
+              << g.arcs() / 2 << " edges" << std::endl;
+
+    util::Timer timer;
+    std::vector<int32_t> order;
+    order.reserve(g.n);
+    graph::Traversal traversal(g);
+    traversal.bfs(source, order);
+    std::cout << "  BFS: " << timer.seconds() << " s" << std::endl;
+
+    timer = util::Timer();
+    std::vector<int32_t> component;
+    const int components = graph::connected_components(g, component);
+    std::cout << "  connected components: " << timer.seconds() << " s"
+              << std::endl;
+
+    const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::vector<int32_t> depth;
+        graph::ParallelBfs top_down(g, threads);
+        top_down.alpha = 0;
+        timer = util::Timer();
+        top_down.run(source, depth);
+        double top_down_time = timer.seconds();
+
+        timer = util::Timer();
+        graph::parallel_bfs(g, source, depth, threads);
+        double bfs_time = timer.seconds();
+
+        std::vector<int32_t> parallel_component;
+        timer = util::Timer();
+        int parallel_components = graph::parallel_connected_components(
+            g, parallel_component, threads);
+        assert(parallel_components == components);
+
+        std::cout << "  " << threads << " threads: BFS top-down "
+                  << top_down_time << " s, direction-optimizing "
+                  << bfs_time << " s; connected components (Afforest) "
+                  << timer.seconds() << " s" << std::endl;
+    }
+}
+
+
+// Compares Dijkstra's algorithm over a std::priority_queue with it over a
+// radix heap, with delta-stepping, and with searches from many sources at
+// once, on an R-MAT graph with weights in [1, 255], on 1, 2, 4, ... threads,
+// up to the hardware's.
+void benchmark_shortest_paths(int scale, int sources) {
+    util::Rng rng(1);
+    graph::Graph g = with_weights(rmat_graph(scale, 16, rng), 1, 255, rng);
+    std::vector<int32_t> source;
+    while ((int) source.size() < sources) {
+        int v = rng.below(g.n);
+        if (g.degree(v) > 0)
+            source.push_back(v);
+    }
+    std::cout << "R-MAT, scale " << scale << ", weighted: n = " << g.n
+              << ", " << g.arcs() << " arcs" << std::endl;
+
+    util::Timer timer;
+    const std::vector<int64_t> expected = heap_dijkstra(g, source[0]);
+    std::cout << "  Dijkstra, std::priority_queue: " << timer.seconds()
+              << " s" << std::endl;
+
+    timer = util::Timer();
+    graph::Dijkstra dijkstra(g);
+    dijkstra.run(source[0]);
+    std::cout << "  Dijkstra, radix heap: " << timer.seconds() << " s"
+              << std::endl;
+    assert(dijkstra.distance == expected);
+
+    timer = util::Timer();
+    for (int i = 0; i < sources; i++)
+        heap_dijkstra(g, source[i]);
+    std::cout << "  " << sources << " sources, std::priority_queue: "
+              << timer.seconds() << " s" << std::endl;
+
+    const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::cout << "  " << threads << " threads: delta-stepping";
+        const int64_t deltas[] = {1, 16, 64, 256};
+        for (int i = 0; i < 4; i++) {
+            std::vector<int64_t> distance;
+            timer = util::Timer();
+            graph::parallel_shortest_paths(g, source[0], deltas[i], distance,
+                                           threads);
+            std::cout << (i > 0 ? ", " : " ") << timer.seconds()
+                      << " s (delta " << deltas[i] << ")";
+            assert(distance == expected);
+        }
+
+        std::vector<std::vector<int64_t> > distances;
+        timer = util::Timer();
+        graph::shortest_paths(g, source, distances, threads);
+        std::cout << "; " << sources << " sources, radix heap "
+                  << timer.seconds() << " s" << std::endl;
+        assert(distances[0] == expected);
+    }
+}
+
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        benchmark_graph_traversal(1 << 22, 1L << 25);
+        benchmark_parallel_traversal(21);
+        benchmark_shortest_paths(20, 8);
+        return 0;
+    }
+
+    test_examples();
+    test_random_graphs();
+    test_parallel_traversal();
+    test_shortest_paths();
+    test_against_python();
+    std::cout << "Tests passed." << std::endl;
+    return 0;
+}
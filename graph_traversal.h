@@ -0,0 +1,1033 @@
+// Copyright (c) 2012 Gregg Gajic <gregg.gajic@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Graph traversal over graphs in CSR form: BFS, DFS, connected components,
+// strongly connected components, topological sort, shortest paths.
+
+#ifndef ALGORITHMS_GRAPH_TRAVERSAL_H
+#define ALGORITHMS_GRAPH_TRAVERSAL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "graph.h"
+#include "util.h"
+
+
+namespace algorithms {
+namespace graph {
+
+// A set of integers in range [0, n), a bit each.
+struct BitVector {
+    std::vector<uint64_t> words;
+
+    BitVector() {}
+    explicit BitVector(long n) : words((n + 63) / 64, 0) {}
+
+    bool test(long i) const {
+        return (words[i >> 6] >> (i & 63)) & 1;
+    }
+
+    void set(long i) {
+        words[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+
+    // Empties the set.
+    void clear() {
+        std::fill(words.begin(), words.end(), 0);
+    }
+};
+
+
+// Searches a graph, marking the vertices visited in a BitVector, which
+// persists from one search to the next, until reset. Searches only visit
+// vertices not already visited.
+//
+// The buffers are allocated once, for all of the graph's vertices, so that
+// searches allocate nothing.
+struct Traversal {
+    const Graph& graph;
+    BitVector visited;
+    // The DFS stack, of vertices, and the next of their arcs to follow.
+    std::vector<std::pair<int32_t, int64_t> > stack;
+
+    explicit Traversal(const Graph& graph)
+        : graph(graph), visited(graph.n) {
+        stack.reserve(graph.n);
+    }
+
+    void reset() {
+        visited.clear();
+    }
+
+    // Appends the vertices reachable from `source` to `order`, in the order
+    // in which a breadth-first search discovers them. `order` serves as the
+    // search's queue, so should have capacity for every vertex.
+    void bfs(int source, std::vector<int32_t>& order) {
+        if (visited.test(source))
+            return;
+        visited.set(source);
+        size_t head = order.size();
+        order.push_back(source);
+
+        for (; head < order.size(); head++) {
+            const int u = order[head];
+            for (int64_t a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+                const int v = graph.targets[a];
+                if (!visited.test(v)) {
+                    visited.set(v);
+                    order.push_back(v);
+                }
+            }
+        }
+    }
+
+    // Searches depth-first from `source`, following arcs in order, without
+    // recursion, and appends the vertices reached to `preorder` as they are
+    // discovered, and to `postorder` as they are finished.
+    void dfs(int source, std::vector<int32_t>& preorder,
+             std::vector<int32_t>& postorder) {
+        if (visited.test(source))
+            return;
+        visit(source, preorder);
+
+        while (!stack.empty()) {
+            const int u = stack.back().first;
+            if (stack.back().second < graph.offsets[u + 1]) {
+                const int v = graph.targets[stack.back().second++];
+                if (!visited.test(v))
+                    visit(v, preorder);
+            } else {
+                postorder.push_back(u);
+                stack.pop_back();
+            }
+        }
+    }
+
+    void visit(int v, std::vector<int32_t>& preorder) {
+        visited.set(v);
+        preorder.push_back(v);
+        stack.push_back(std::make_pair(v, graph.offsets[v]));
+    }
+};
+
+
+// Labels each vertex of an undirected graph with its connected component,
+// numbered 0, 1, ... in order of their least vertices, and returns the
+// number of components.
+int connected_components(const Graph& graph, std::vector<int32_t>& component) {
+    component.assign(graph.n, -1);
+    Traversal traversal(graph);
+    std::vector<int32_t> order;
+    order.reserve(graph.n);
+
+    int components = 0;
+    for (int s = 0; s < graph.n; s++) {
+        if (traversal.visited.test(s))
+            continue;
+        order.clear();
+        traversal.bfs(s, order);
+        for (size_t i = 0; i < order.size(); i++)
+            component[order[i]] = components;
+        components++;
+    }
+    return components;
+}
+
+
+// Labels each vertex of a directed graph with its strongly connected
+// component, and returns the number of components, by Tarjan's algorithm,
+// without recursion. Components are numbered in reverse topological order:
+// no arc leads from a component to one numbered higher.
+//
+// See: Tarjan, "Depth-first search and linear graph algorithms" (1972).
+int strongly_connected_components(const Graph& graph,
+                                  std::vector<int32_t>& component) {
+    component.assign(graph.n, -1);
+    // index[v] numbers v in order of discovery, or is -1 if undiscovered;
+    // low[v] is the least index reachable from v's subtree by at most one
+    // arc to a vertex whose component is yet unknown.
+    std::vector<int32_t> index(graph.n, -1), low(graph.n);
+    std::vector<int32_t> unassigned;
+    std::vector<std::pair<int32_t, int64_t> > stack;
+
+    int discovered = 0, components = 0;
+    for (int s = 0; s < graph.n; s++) {
+        if (index[s] >= 0)
+            continue;
+        index[s] = low[s] = discovered++;
+        unassigned.push_back(s);
+        stack.push_back(std::make_pair(s, graph.offsets[s]));
+
+        while (!stack.empty()) {
+            const int u = stack.back().first;
+            if (stack.back().second < graph.offsets[u + 1]) {
+                const int v = graph.targets[stack.back().second++];
+                if (index[v] < 0) {
+                    index[v] = low[v] = discovered++;
+                    unassigned.push_back(v);
+                    stack.push_back(std::make_pair(v, graph.offsets[v]));
+                } else if (component[v] < 0) {
+                    low[u] = std::min(low[u], index[v]);
+                }
+                continue;
+            }
+
+            stack.pop_back();
+            if (!stack.empty()) {
+                const int parent = stack.back().first;
+                low[parent] = std::min(low[parent], low[u]);
+            }
+            if (low[u] == index[u]) {
+                int v;
+                do {
+                    v = unassigned.back();
+                    unassigned.pop_back();
+                    component[v] = components;
+                } while (v != u);
+                components++;
+            }
+        }
+    }
+    return components;
+}
+
+
+// Writes the vertices of a directed acyclic graph to `order`, such that every
+// arc leads forward, as the reverse of the order in which depth-first
+// searches from each vertex in turn finish them. Returns false, should the
+// graph have a cycle.
+bool topological_sort(const Graph& graph, std::vector<int32_t>& order) {
+    Traversal traversal(graph);
+    std::vector<int32_t> preorder;
+    order.clear();
+    order.reserve(graph.n);
+    preorder.reserve(graph.n);
+    for (int s = 0; s < graph.n; s++)
+        traversal.dfs(s, preorder, order);
+    std::reverse(order.begin(), order.end());
+
+    std::vector<int32_t> position(graph.n);
+    for (int i = 0; i < graph.n; i++)
+        position[order[i]] = i;
+    for (int u = 0; u < graph.n; u++) {
+        for (int64_t a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+            if (position[graph.targets[a]] <= position[u])
+                return false;
+        }
+    }
+    return true;
+}
+
+
+// Blocks the threads that call wait until `count` of them have, then
+// releases them all, and may be waited on again.
+struct Barrier {
+    const int count;
+    int waiting;
+    long generation;
+    std::mutex mutex;
+    std::condition_variable released;
+
+    explicit Barrier(int count) : count(count), waiting(0), generation(0) {}
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        const long arrived = generation;
+        if (++waiting == count) {
+            waiting = 0;
+            generation++;
+            released.notify_all();
+        } else {
+            while (generation == arrived)
+                released.wait(lock);
+        }
+    }
+};
+
+
+// Runs the phases of a parallel computation, member functions of a T taking
+// a thread number, on `threads` threads: the caller, as thread 0, and
+// threads started once, by start, which wait on a barrier between phases
+// until stop.
+template <typename T>
+struct PhaseThreads {
+    T* const owner;
+    const int threads;
+    // The phase the threads run next, or NULL once stopped.
+    void (T::*phase)(int);
+    Barrier barrier;
+    std::vector<std::thread> workers;
+
+    PhaseThreads(T* owner, int threads)
+        : owner(owner), threads(threads), phase(NULL), barrier(threads) {}
+
+    void start() {
+        for (int t = 1; t < threads; t++)
+            workers.push_back(std::thread(&PhaseThreads::work, this, t));
+    }
+
+    // Runs phase(t) on each thread t, and returns once every thread has.
+    void run(void (T::*phase)(int)) {
+        this->phase = phase;
+        barrier.wait();
+        (owner->*phase)(0);
+        barrier.wait();
+    }
+
+    void stop() {
+        phase = NULL;
+        barrier.wait();
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+        workers.clear();
+    }
+
+    void work(int t) {
+        for (;;) {
+            barrier.wait();
+            if (phase == NULL)
+                return;
+            (owner->*phase)(t);
+            barrier.wait();
+        }
+    }
+};
+
+
+// Breadth-first search of an undirected graph on many threads, switching
+// between two ways of expanding the frontier, the set of vertices at the
+// current depth, as Beamer, Asanović and Patterson do:
+//
+//  - Top-down, each vertex of the frontier claims its unvisited neighbors,
+//    by compare-and-swap, and the claimed vertices are appended to the next
+//    frontier in chunks, each thread reserving space by fetch-and-add.
+//  - Bottom-up, each unvisited vertex looks for a neighbor in the frontier,
+//    held as a bitmap, stopping at the first. Threads take blocks of 64
+//    vertices, so that each bitmap word has one writer.
+//
+// Top-down steps examine every arc leaving the frontier, bottom-up steps
+// the arcs leaving every unvisited vertex, until one reaches the frontier,
+// which is far fewer once the frontier holds much of the graph. The search
+// goes bottom-up once the arcs leaving the frontier outnumber those left
+// unexamined by a factor of 1 / alpha, and back once the frontier shrinks
+// below n / beta vertices. An alpha of 0 keeps it top-down. The threads are
+// started once per search, and wait on a barrier between steps.
+//
+// See: Beamer et al., "Direction-optimizing breadth-first search" (2012).
+struct ParallelBfs {
+    const Graph& graph;
+    const int threads;
+    int alpha;
+    int beta;
+    // depth[v] is v's distance from the source, or -1 if unvisited.
+    std::vector<std::atomic<int32_t> > depth;
+    std::vector<int32_t> frontier;
+    long frontier_size;
+    std::vector<int32_t> next;
+    std::atomic<long> next_size;
+    BitVector frontier_bitmap;
+    BitVector next_bitmap;
+    int32_t level;
+    // Each thread's buffer of claimed vertices, and the number of vertices
+    // it has visited in the last step, and the sum of their degrees.
+    std::vector<std::vector<int32_t> > buffers;
+    std::vector<long> visited;
+    std::vector<int64_t> visited_arcs;
+    PhaseThreads<ParallelBfs> workers;
+
+    static const long chunk_size = 1024;
+
+    ParallelBfs(const Graph& graph, int threads)
+        : graph(graph), threads(threads), alpha(15), beta(18),
+          depth(graph.n), frontier(graph.n), next(graph.n),
+          frontier_bitmap(graph.n), next_bitmap(graph.n), buffers(threads),
+          visited(threads), visited_arcs(threads), workers(this, threads) {}
+
+    // Writes the depth of each vertex from `source` to `result`, or -1 for
+    // vertices it doesn't reach.
+    void run(int source, std::vector<int32_t>& result) {
+        workers.start();
+        run_on_threads(&ParallelBfs::reset);
+        depth[source] = 0;
+        frontier[0] = source;
+        frontier_size = 1;
+        level = 0;
+
+        int64_t unexamined_arcs = graph.arcs();
+        int64_t frontier_arcs = graph.degree(source);
+        while (frontier_size > 0) {
+            if (alpha > 0 && frontier_arcs > unexamined_arcs / alpha) {
+                to_bitmap();
+                long awake = frontier_size, last_awake;
+                do {
+                    // A bottom-up step finds what a top-down step would, so
+                    // counts the arcs leaving the frontier as examined.
+                    unexamined_arcs -= frontier_arcs;
+                    last_awake = awake;
+                    next_bitmap.clear();
+                    run_on_threads(&ParallelBfs::bottom_up);
+                    frontier_bitmap.words.swap(next_bitmap.words);
+                    level++;
+                    awake = sum(visited);
+                    frontier_arcs = sum(visited_arcs);
+                } while (awake > 0 && (awake >= last_awake
+                                       || awake > graph.n / beta));
+                to_queue();
+            } else {
+                unexamined_arcs -= frontier_arcs;
+                next_size = 0;
+                run_on_threads(&ParallelBfs::top_down);
+                frontier.swap(next);
+                frontier_size = next_size;
+                level++;
+                frontier_arcs = sum(visited_arcs);
+            }
+        }
+        workers.stop();
+
+        result.resize(graph.n);
+        for (int v = 0; v < graph.n; v++)
+            result[v] = depth[v].load(std::memory_order_relaxed);
+    }
+
+    void reset(int t) {
+        for (long v = range_begin(graph.n, t); v < range_begin(graph.n, t + 1);
+                v++)
+            depth[v].store(-1, std::memory_order_relaxed);
+    }
+
+    void top_down(int t) {
+        std::vector<int32_t>& buffer = buffers[t];
+        int64_t arcs = 0;
+        for (long i = range_begin(frontier_size, t);
+                i < range_begin(frontier_size, t + 1); i++) {
+            const int u = frontier[i];
+            for (int64_t a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+                const int v = graph.targets[a];
+                int32_t unvisited = -1;
+                if (depth[v].load(std::memory_order_relaxed) < 0
+                        && depth[v].compare_exchange_strong(
+                               unvisited, level + 1,
+                               std::memory_order_relaxed)) {
+                    buffer.push_back(v);
+                    arcs += graph.degree(v);
+                    if (buffer.size() == chunk_size)
+                        flush(buffer);
+                }
+            }
+        }
+        flush(buffer);
+        visited_arcs[t] = arcs;
+    }
+
+    // Appends the buffer to the next frontier.
+    void flush(std::vector<int32_t>& buffer) {
+        long at = next_size.fetch_add(buffer.size());
+        std::copy(buffer.begin(), buffer.end(), next.begin() + at);
+        buffer.clear();
+    }
+
+    void bottom_up(int t) {
+        const long words = frontier_bitmap.words.size();
+        const long first = range_begin(words, t) * 64;
+        const long last = std::min<long>(range_begin(words, t + 1) * 64,
+                                         graph.n);
+        long awake = 0;
+        int64_t arcs = 0;
+        for (long v = first; v < last; v++) {
+            if (depth[v].load(std::memory_order_relaxed) >= 0)
+                continue;
+            for (int64_t a = graph.offsets[v]; a < graph.offsets[v + 1]; a++) {
+                if (frontier_bitmap.test(graph.targets[a])) {
+                    depth[v].store(level + 1, std::memory_order_relaxed);
+                    next_bitmap.set(v);
+                    awake++;
+                    arcs += graph.degree(v);
+                    break;
+                }
+            }
+        }
+        visited[t] = awake;
+        visited_arcs[t] = arcs;
+    }
+
+    void to_bitmap() {
+        frontier_bitmap.clear();
+        for (long i = 0; i < frontier_size; i++)
+            frontier_bitmap.set(frontier[i]);
+    }
+
+    void to_queue() {
+        frontier_size = 0;
+        for (size_t w = 0; w < frontier_bitmap.words.size(); w++) {
+            for (uint64_t word = frontier_bitmap.words[w]; word != 0;
+                    word &= word - 1)
+                frontier[frontier_size++] = w * 64 + __builtin_ctzll(word);
+        }
+    }
+
+    // Returns the start of thread t's share of [0, n).
+    long range_begin(long n, int t) const {
+        return n * t / threads;
+    }
+
+    template <typename T>
+    static T sum(const std::vector<T>& values) {
+        T total = 0;
+        for (size_t t = 0; t < values.size(); t++)
+            total += values[t];
+        return total;
+    }
+
+    void run_on_threads(void (ParallelBfs::*phase)(int)) {
+        workers.run(phase);
+    }
+};
+
+
+// Writes the depth of each vertex of an undirected graph from `source` to
+// `depth`, or -1 for vertices it doesn't reach, using `threads` threads.
+void parallel_bfs(const Graph& graph, int source, std::vector<int32_t>& depth,
+                  int threads) {
+    ParallelBfs(graph, threads).run(source, depth);
+}
+
+
+// Finds the connected components of an undirected graph on many threads,
+// by Sutton et al.'s Afforest, a union-find without locks.
+//
+// Each vertex starts as a tree of its own, and linking two vertices hooks
+// the root of the higher-numbered tree under the lower, by compare-and-swap,
+// so that a tree's root is its least vertex. Linking each vertex to its
+// first two neighbors, and compressing every path, is likely to join most
+// of the vertices of a large component; a sample of the vertices then finds
+// that component, whose vertices skip their remaining arcs, as those arcs
+// that leave it are linked from their other ends.
+//
+// See: Sutton et al., "Optimizing parallel graph connectivity computation
+// via subgraph sampling" (2018).
+struct ParallelComponents {
+    const Graph& graph;
+    const int threads;
+    std::vector<std::atomic<int32_t> > parent;
+    // The number of neighbors each vertex is linked to before sampling.
+    int rounds;
+    int32_t largest;
+    std::vector<int32_t>& component;
+    std::vector<int32_t> roots;
+
+    static const int sampling_rounds = 2;
+    static const int samples = 1024;
+
+    ParallelComponents(const Graph& graph, int threads,
+                       std::vector<int32_t>& component)
+        : graph(graph), threads(threads), parent(graph.n), largest(-1),
+          component(component), roots(threads + 1) {}
+
+    // Labels each vertex with its component, numbered as by
+    // connected_components, and returns the number of components.
+    int run() {
+        run_on_threads(&ParallelComponents::reset);
+        for (rounds = 0; rounds < sampling_rounds; rounds++) {
+            run_on_threads(&ParallelComponents::link_neighbor);
+            run_on_threads(&ParallelComponents::compress);
+        }
+
+        util::Rng rng(1);
+        std::vector<int32_t> sample;
+        for (int i = 0; i < samples && graph.n > 0; i++)
+            sample.push_back(parent[rng.below(graph.n)]);
+        std::sort(sample.begin(), sample.end());
+        for (int i = 0, run = 0, longest = 0; i < (int) sample.size(); i++) {
+            run = i > 0 && sample[i] == sample[i - 1] ? run + 1 : 1;
+            if (run > longest) {
+                longest = run;
+                largest = sample[i];
+            }
+        }
+
+        run_on_threads(&ParallelComponents::link_rest);
+        run_on_threads(&ParallelComponents::compress);
+
+        // Number the roots in order, as they are the least vertices of
+        // their components.
+        component.resize(graph.n);
+        run_on_threads(&ParallelComponents::count_roots);
+        for (int t = 0; t < threads; t++)
+            roots[t + 1] += roots[t];
+        run_on_threads(&ParallelComponents::number_roots);
+        run_on_threads(&ParallelComponents::label);
+        return roots[threads];
+    }
+
+    void reset(int t) {
+        for (long v = range_begin(t); v < range_begin(t + 1); v++)
+            parent[v].store(v, std::memory_order_relaxed);
+    }
+
+    // Links each vertex to its neighbor number `rounds`.
+    void link_neighbor(int t) {
+        for (long u = range_begin(t); u < range_begin(t + 1); u++) {
+            if (rounds < graph.degree(u))
+                link(u, graph.targets[graph.offsets[u] + rounds]);
+        }
+    }
+
+    // Links each vertex outside the largest component to the neighbors it
+    // has yet to be linked to.
+    void link_rest(int t) {
+        for (long u = range_begin(t); u < range_begin(t + 1); u++) {
+            if (parent[u].load(std::memory_order_relaxed) == largest)
+                continue;
+            for (int64_t a = graph.offsets[u] + sampling_rounds;
+                    a < graph.offsets[u + 1]; a++)
+                link(u, graph.targets[a]);
+        }
+    }
+
+    void link(int32_t u, int32_t v) {
+        int32_t p1 = parent[u].load(std::memory_order_relaxed);
+        int32_t p2 = parent[v].load(std::memory_order_relaxed);
+        while (p1 != p2) {
+            int32_t high = std::max(p1, p2), low = std::min(p1, p2);
+            int32_t p_high = parent[high].load(std::memory_order_relaxed);
+            // Already linked, or high is a root, now hooked under low.
+            if (p_high == low || (p_high == high
+                    && parent[high].compare_exchange_strong(
+                           p_high, low, std::memory_order_relaxed)))
+                break;
+            p1 = parent[parent[high].load(std::memory_order_relaxed)]
+                .load(std::memory_order_relaxed);
+            p2 = parent[low].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Points each vertex directly at its root.
+    void compress(int t) {
+        for (long v = range_begin(t); v < range_begin(t + 1); v++) {
+            int32_t p = parent[v].load(std::memory_order_relaxed);
+            while (p != parent[p].load(std::memory_order_relaxed)) {
+                p = parent[p].load(std::memory_order_relaxed);
+                parent[v].store(p, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void count_roots(int t) {
+        int32_t count = 0;
+        for (long v = range_begin(t); v < range_begin(t + 1); v++)
+            count += parent[v].load(std::memory_order_relaxed) == v;
+        roots[t + 1] = count;
+    }
+
+    void number_roots(int t) {
+        int32_t next = roots[t];
+        for (long v = range_begin(t); v < range_begin(t + 1); v++) {
+            if (parent[v].load(std::memory_order_relaxed) == v)
+                component[v] = next++;
+        }
+    }
+
+    void label(int t) {
+        for (long v = range_begin(t); v < range_begin(t + 1); v++) {
+            int32_t root = parent[v].load(std::memory_order_relaxed);
+            if (root != v)
+                component[v] = component[root];
+        }
+    }
+
+    long range_begin(int t) const {
+        return (long)graph.n * t / threads;
+    }
+
+    void run_on_threads(void (ParallelComponents::*phase)(int)) {
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.push_back(std::thread(phase, this, t));
+        (this->*phase)(0);
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+    }
+};
+
+
+// Labels each vertex of an undirected graph with its connected component,
+// as connected_components does, using `threads` threads.
+int parallel_connected_components(const Graph& graph,
+                                  std::vector<int32_t>& component,
+                                  int threads) {
+    return ParallelComponents(graph, threads, component).run();
+}
+
+
+// The distance to a vertex that can't be reached.
+const int64_t no_path = std::numeric_limits<int64_t>::max();
+
+
+// A min-priority queue of vertices keyed by integers, whose keys may be no
+// less than the last key popped, as in Dijkstra's algorithm.
+//
+// An entry is kept in bucket i > 0 if its key first differs from the last
+// key popped in bit i - 1, counting from the least significant, or in
+// bucket 0 if it equals it. Popping from an empty bucket 0 takes the least
+// key of the first non-empty bucket, and moves that bucket's entries to
+// lower buckets, so that each entry moves at most 64 times.
+//
+// See: Ahuja et al., "Faster algorithms for the shortest path problem"
+// (1990).
+struct RadixHeap {
+    typedef std::pair<uint64_t, int32_t> Entry;
+
+    std::vector<Entry> buckets[65];
+    uint64_t last;
+    long size;
+
+    RadixHeap() : last(0), size(0) {}
+
+    bool empty() const {
+        return size == 0;
+    }
+
+    void clear() {
+        for (int i = 0; i < 65; i++)
+            buckets[i].clear();
+        last = 0;
+        size = 0;
+    }
+
+    void push(uint64_t key, int32_t v) {
+        buckets[bucket(key)].push_back(Entry(key, v));
+        size++;
+    }
+
+    Entry pop() {
+        if (buckets[0].empty()) {
+            int i = 1;
+            while (buckets[i].empty())
+                i++;
+            last = buckets[i][0].first;
+            for (size_t j = 1; j < buckets[i].size(); j++)
+                last = std::min(last, buckets[i][j].first);
+            for (size_t j = 0; j < buckets[i].size(); j++)
+                buckets[bucket(buckets[i][j].first)].push_back(buckets[i][j]);
+            buckets[i].clear();
+        }
+        Entry entry = buckets[0].back();
+        buckets[0].pop_back();
+        size--;
+        return entry;
+    }
+
+    int bucket(uint64_t key) const {
+        return key == last ? 0 : 64 - __builtin_clzll(key ^ last);
+    }
+};
+
+
+// Finds shortest paths from one source at a time, by Dijkstra's algorithm,
+// over a RadixHeap, in a graph with non-negative integer weights.
+//
+// distance[v] is the length of a shortest path from the last source to v,
+// or no_path. Each search resets only the distances the last one set, so
+// that many searches that each reach few vertices take time in proportion
+// to those vertices, not to the graph.
+struct Dijkstra {
+    const Graph& graph;
+    std::vector<int64_t> distance;
+    std::vector<int32_t> reached;
+    RadixHeap heap;
+
+    explicit Dijkstra(const Graph& graph)
+        : graph(graph), distance(graph.n, no_path) {}
+
+    void run(int source) {
+        for (size_t i = 0; i < reached.size(); i++)
+            distance[reached[i]] = no_path;
+        reached.clear();
+        heap.clear();
+
+        distance[source] = 0;
+        reached.push_back(source);
+        heap.push(0, source);
+        while (!heap.empty()) {
+            RadixHeap::Entry entry = heap.pop();
+            const int u = entry.second;
+            // Skip entries for vertices since reached by shorter paths.
+            if ((int64_t) entry.first > distance[u])
+                continue;
+            for (int64_t a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+                const int v = graph.targets[a];
+                const int64_t d = distance[u] + graph.weight(a);
+                if (d < distance[v]) {
+                    if (distance[v] == no_path)
+                        reached.push_back(v);
+                    distance[v] = d;
+                    heap.push(d, v);
+                }
+            }
+        }
+    }
+};
+
+
+// Writes the distances from `source` to each vertex to `distance`, as
+// Dijkstra does.
+void shortest_paths(const Graph& graph, int source,
+                    std::vector<int64_t>& distance) {
+    Dijkstra dijkstra(graph);
+    dijkstra.run(source);
+    distance.swap(dijkstra.distance);
+}
+
+
+// Searches from every `threads`th of `sources`, starting with source t.
+void shortest_paths_each(const Graph* graph,
+                         const std::vector<int32_t>* sources,
+                         std::vector<std::vector<int64_t> >* distances,
+                         int t, int threads) {
+    Dijkstra dijkstra(*graph);
+    for (size_t i = t; i < sources->size(); i += threads) {
+        dijkstra.run((*sources)[i]);
+        (*distances)[i] = dijkstra.distance;
+    }
+}
+
+
+// Writes the distances from each of `sources` to each vertex to the
+// corresponding element of `distances`, using `threads` threads, each
+// searching from every `threads`th source with a Dijkstra of its own.
+void shortest_paths(const Graph& graph, const std::vector<int32_t>& sources,
+                    std::vector<std::vector<int64_t> >& distances,
+                    int threads) {
+    distances.resize(sources.size());
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++) {
+        workers.push_back(std::thread(shortest_paths_each, &graph, &sources,
+                                      &distances, t, threads));
+    }
+    shortest_paths_each(&graph, &sources, &distances, 0, threads);
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+}
+
+
+// Finds shortest paths from a source on many threads, by Meyer and
+// Sanders's delta-stepping, as in the GAP benchmark suite.
+//
+// Vertices are binned by distance, bin i holding those at distances in
+// [i delta, (i + 1) delta). The lowest non-empty bin is the frontier, which
+// the threads share out, relaxing the arcs from each vertex, by
+// compare-and-swap, and binning those vertices whose distances improve in
+// bins of their own. The next frontier is the lowest bin non-empty on any
+// thread, which may be the same as the last, gathered by fetch-and-add.
+// Vertices are binned again each time their distance improves, and skipped
+// if found in a frontier beyond their distance's bin.
+//
+// Each thread keeps only `window` bins, reused in turn: bin i is kept in
+// slot i % window while it lies in the window [base, base + window), and
+// in an overflow bin beyond it. Once the window is empty, it moves to the
+// lowest overflowing bin, and the overflow is binned again. The threads are
+// started once per search, and wait on a barrier between steps.
+//
+// A delta of 1 makes this a parallel Dijkstra's algorithm, with a frontier
+// per distance; a larger delta gives larger frontiers, each of whose
+// vertices may be relaxed more than once.
+//
+// See: Meyer and Sanders, "Delta-stepping: a parallelizable shortest path
+// algorithm" (2003).
+struct DeltaStepping {
+    const Graph& graph;
+    const int threads;
+    const int64_t delta;
+    long window;
+    std::vector<std::atomic<int64_t> > distance;
+    std::vector<int32_t> frontier;
+    std::atomic<long> frontier_size;
+    long bin;
+    long base;
+    // Each thread's bins, the last of them its overflow, the lowest bin
+    // non-empty after a step, and the lowest bin put in its overflow.
+    std::vector<std::vector<std::vector<int32_t> > > bins;
+    std::vector<long> next_bin;
+    std::vector<long> overflow_bin;
+    PhaseThreads<DeltaStepping> workers;
+
+    // Requires delta >= 1.
+    DeltaStepping(const Graph& graph, int threads, int64_t delta)
+        : graph(graph), threads(threads), delta(delta), window(1024),
+          distance(graph.n), frontier(1), bins(threads), next_bin(threads),
+          overflow_bin(threads), workers(this, threads) {
+        assert(delta >= 1);
+    }
+
+    void run(int source, std::vector<int64_t>& result) {
+        for (int t = 0; t < threads; t++) {
+            bins[t].assign(window + 1, std::vector<int32_t>());
+            overflow_bin[t] = no_bin;
+        }
+        workers.start();
+        run_on_threads(&DeltaStepping::reset);
+        distance[source] = 0;
+        frontier[0] = source;
+        frontier_size = 1;
+        bin = 0;
+        base = 0;
+
+        while (frontier_size > 0) {
+            run_on_threads(&DeltaStepping::relax);
+            bin = lowest_next_bin();
+            // The lowest overflowing bin may hold only vertices since
+            // binned lower, so the window may be empty once moved.
+            while (bin != no_bin && bin >= base + window) {
+                base = bin - bin % window;
+                run_on_threads(&DeltaStepping::rebin_overflow);
+                bin = lowest_next_bin();
+            }
+            frontier_size = 0;
+            if (bin == no_bin)
+                break;
+            long size = 0;
+            for (int t = 0; t < threads; t++)
+                size += bins[t][bin % window].size();
+            if ((long) frontier.size() < size)
+                frontier.resize(size);
+            run_on_threads(&DeltaStepping::gather);
+        }
+
+        workers.stop();
+
+        result.resize(graph.n);
+        for (int v = 0; v < graph.n; v++)
+            result[v] = distance[v].load(std::memory_order_relaxed);
+    }
+
+    static const long no_bin = std::numeric_limits<long>::max();
+
+    void reset(int t) {
+        for (long v = range_begin(graph.n, t); v < range_begin(graph.n, t + 1);
+                v++)
+            distance[v].store(no_path, std::memory_order_relaxed);
+    }
+
+    void relax(int t) {
+        const long size = frontier_size;
+        for (long i = range_begin(size, t); i < range_begin(size, t + 1);
+                i++) {
+            const int u = frontier[i];
+            const int64_t du = distance[u].load(std::memory_order_relaxed);
+            if (du / delta < bin)
+                continue;
+            for (int64_t a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+                const int v = graph.targets[a];
+                const int64_t d = du + graph.weight(a);
+                int64_t old = distance[v].load(std::memory_order_relaxed);
+                while (d < old && !distance[v].compare_exchange_weak(
+                           old, d, std::memory_order_relaxed))
+                    ;
+                if (d < old)
+                    put(t, v, d / delta);
+            }
+        }
+        find_next_bin(t, bin);
+    }
+
+    // Finds thread t's lowest non-empty bin from bin `from` on. Bins in the
+    // window are all below those in the overflow.
+    void find_next_bin(int t, long from) {
+        next_bin[t] = overflow_bin[t];
+        for (long b = from; b < base + window; b++) {
+            if (!bins[t][b % window].empty()) {
+                next_bin[t] = b;
+                return;
+            }
+        }
+    }
+
+    long lowest_next_bin() const {
+        long lowest = no_bin;
+        for (int t = 0; t < threads; t++)
+            lowest = std::min(lowest, next_bin[t]);
+        return lowest;
+    }
+
+    // Bins v, whose distance is in bin b, on thread t.
+    void put(int t, int32_t v, long b) {
+        if (b < base + window) {
+            bins[t][b % window].push_back(v);
+        } else {
+            bins[t][window].push_back(v);
+            overflow_bin[t] = std::min(overflow_bin[t], b);
+        }
+    }
+
+    // Bins the overflow again, now the window has moved. Vertices since
+    // binned at shorter distances, below the window, are dropped.
+    void rebin_overflow(int t) {
+        std::vector<int32_t> overflow;
+        overflow.swap(bins[t][window]);
+        overflow_bin[t] = no_bin;
+        for (size_t i = 0; i < overflow.size(); i++) {
+            const int32_t v = overflow[i];
+            const long b =
+                distance[v].load(std::memory_order_relaxed) / delta;
+            if (b >= base)
+                put(t, v, b);
+        }
+        find_next_bin(t, base);
+    }
+
+    // Moves each thread's share of the next frontier into it.
+    void gather(int t) {
+        std::vector<int32_t>& mine = bins[t][bin % window];
+        long at = frontier_size.fetch_add(mine.size());
+        std::copy(mine.begin(), mine.end(), frontier.begin() + at);
+        mine.clear();
+    }
+
+    long range_begin(long n, int t) const {
+        return n * t / threads;
+    }
+
+    void run_on_threads(void (DeltaStepping::*phase)(int)) {
+        workers.run(phase);
+    }
+};
+
+
+// Writes the distances from `source` to each vertex to `distance`, as
+// Dijkstra does, by delta-stepping on `threads` threads. Requires delta >= 1.
+void parallel_shortest_paths(const Graph& graph, int source, int64_t delta,
+                             std::vector<int64_t>& distance, int threads) {
+    DeltaStepping(graph, threads, delta).run(source, distance);
+}
+
+}  // namespace graph
+}  // namespace algorithms
+
+#endif  // ALGORITHMS_GRAPH_TRAVERSAL_H
@@ -21,18 +21,27 @@
 // Minimum cut
 // See: http://en.wikipedia.org/wiki/Cut_(graph_theory)#Minimum_cut'''
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <ctime>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <queue>
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "graph.h"
 #include "util.h"
 
 
+namespace graph = algorithms::graph;
 namespace util = algorithms::util;
 
 
@@ -40,87 +49,777 @@ typedef std::string Vertex;
 typedef std::pair<Vertex, Vertex> Edge;
 
 
+// An undirected multigraph over vertices 0, 1, ..., n - 1, as a list of
+// edges.
+struct Multigraph {
+    typedef std::pair<int, int> Edge;
 
-// Given an undirected graph consisting of n vertices and m edges,
-// returns a *possible* min cut after n - 1 edge contractions, where edges are
-// chosen uniformly at random (Karger's algorithm).
+    int n;
+    std::vector<Edge> edges;
+
+    Multigraph() : n(0) {}
+    explicit Multigraph(int n) : n(n) {}
+
+    // The edges of an undirected graph, which has an arc each way for each
+    // edge, less its self-loops.
+    explicit Multigraph(const graph::Graph& graph) : n(graph.n) {
+        for (int u = 0; u < graph.n; u++) {
+            for (int64_t a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+                if (u < graph.targets[a])
+                    edges.push_back(Edge(u, graph.targets[a]));
+            }
+        }
+    }
+};
+
+
+// An edge of weight `weight` between vertices u and v. Edges are ordered by
+// their endpoints.
+struct WeightedEdge {
+    int u;
+    int v;
+    long weight;
+
+    WeightedEdge() : u(0), v(0), weight(0) {}
+    WeightedEdge(int u, int v, long weight) : u(u), v(v), weight(weight) {}
+
+    bool operator<(const WeightedEdge& other) const {
+        return u < other.u || (u == other.u && v < other.v);
+    }
+};
+
+
+// Copies the m edges from `from` to `to`, stably sorted by their `endpoint`,
+// which is below n, by a counting sort.
+void sort_by_endpoint(const WeightedEdge* from, long m, WeightedEdge* to,
+                      int n, int WeightedEdge::*endpoint) {
+    std::vector<long> start(n + 1, 0);
+    for (long e = 0; e < m; e++)
+        start[from[e].*endpoint + 1]++;
+    for (int v = 0; v < n; v++)
+        start[v + 1] += start[v];
+    for (long e = 0; e < m; e++)
+        to[start[from[e].*endpoint]++] = from[e];
+}
+
+
+// Merges the parallel edges in edges[first, end), whose endpoints are below
+// n, into one edge each, u < v, weighing the sum of their weights, in
+// O(m + n) time, sorting the edges by a radix sort on their endpoints.
+void merge_parallel_edges(std::vector<WeightedEdge>& edges, long first,
+                          int n) {
+    const long m = edges.size() - first;
+    for (long e = first; e < (long) edges.size(); e++) {
+        if (edges[e].u > edges[e].v)
+            std::swap(edges[e].u, edges[e].v);
+    }
+    std::vector<WeightedEdge> by_v(m);
+    sort_by_endpoint(edges.data() + first, m, by_v.data(), n,
+                     &WeightedEdge::v);
+    sort_by_endpoint(by_v.data(), m, edges.data() + first, n,
+                     &WeightedEdge::u);
+
+    long last = first;
+    for (long e = first; e < (long) edges.size(); e++) {
+        if (last > first && !(edges[last - 1] < edges[e]))
+            edges[last - 1].weight += edges[e].weight;
+        else
+            edges[last++] = edges[e];
+    }
+    edges.resize(last);
+}
+
+
+// An undirected graph over vertices 0, 1, ..., n - 1 with positive integer
+// edge weights, as a list of edges.
+struct WeightedGraph {
+    int n;
+    std::vector<WeightedEdge> edges;
+
+    WeightedGraph() : n(0) {}
+    explicit WeightedGraph(int n) : n(n) {}
+
+    // The multigraph's edges, without self-loops, with parallel edges
+    // merged into one edge, weighing their number.
+    explicit WeightedGraph(const Multigraph& graph) : n(graph.n) {
+        for (size_t e = 0; e < graph.edges.size(); e++) {
+            const Multigraph::Edge& edge = graph.edges[e];
+            if (edge.first != edge.second)
+                edges.push_back(WeightedEdge(edge.first, edge.second, 1));
+        }
+        merge_parallel_edges(edges, 0, n);
+    }
+
+    // The edges of an undirected graph, as for a Multigraph, with their
+    // weights, or 1 if it is unweighted.
+    explicit WeightedGraph(const graph::Graph& graph) : n(graph.n) {
+        for (int u = 0; u < graph.n; u++) {
+            for (int64_t a = graph.offsets[u]; a < graph.offsets[u + 1]; a++) {
+                int v = graph.targets[a];
+                if (u < v)
+                    edges.push_back(WeightedEdge(u, v, graph.weight(a)));
+            }
+        }
+        merge_parallel_edges(edges, 0, n);
+    }
+};
+
+
+// Runs trials of Karger's algorithm on a multigraph, reusing its buffers
+// from one trial to the next, so that a trial allocates nothing.
+//
+// Contracting an edge chosen uniformly at random, and discarding the
+// self-loops it leaves, until two vertices remain is equivalent to
+// contracting the edges in a uniformly random order, skipping those whose
+// endpoints are already merged. A trial thus shuffles the edges (lazily,
+// stopping once two vertices remain) and tracks the merged vertices with a
+// union-find, in O(m α(n)) time.
 //
 // See: http://en.wikipedia.org/wiki/Karger%27s_algorithm
-std::vector<Edge> randomized_contraction(const std::vector<Vertex>& vertices,
-                                         const std::vector<Edge>& edges) {
-    std::vector<Edge> contracted_edges(edges);
-
-    for (int i = 0; i < vertices.size() - 2; i++) {
-        int rand_edge_index = util::randint(contracted_edges.size())();
-        Edge rand_edge = contracted_edges[rand_edge_index];
-
-        Vertex super_vertex = "(" + rand_edge.first + ", " + rand_edge.second
-                              + ")";
-
-        std::vector<Edge>::iterator i = contracted_edges.begin();
-        while (i != contracted_edges.end()) {
-            if (i->first == rand_edge.first || i->first == rand_edge.second)
-                i->first = super_vertex;
-            if (i->second == rand_edge.first || i->second == rand_edge.second)
-                i->second = super_vertex;
-            // remove self-loops
-            if (i->first == i->second)
-                i = contracted_edges.erase(i);
+struct ContractionEngine {
+    const Multigraph& graph;
+    // parent[v] is v's parent in the union-find forest, or v at a root.
+    std::vector<int> parent;
+    std::vector<int> order;
+
+    explicit ContractionEngine(const Multigraph& graph)
+        : graph(graph), parent(graph.n), order(graph.edges.size()) {
+        for (size_t e = 0; e < order.size(); e++)
+            order[e] = e;
+    }
+
+    int find(int v) {
+        while (parent[v] != v) {
+            // Path halving.
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    }
+
+    // Contracts the graph down to two vertices, and returns the number of
+    // edges between them: a *possible* min cut. Should the graph be
+    // disconnected, returns 0.
+    long trial(util::Rng& rng) {
+        for (int v = 0; v < graph.n; v++)
+            parent[v] = v;
+
+        const long m = order.size();
+        int vertices = graph.n;
+        for (long e = 0; e < m && vertices > 2; e++) {
+            std::swap(order[e], order[e + rng.below(m - e)]);
+            const Multigraph::Edge& edge = graph.edges[order[e]];
+            int u = find(edge.first);
+            int v = find(edge.second);
+            if (u != v) {
+                parent[u] = v;
+                vertices--;
+            }
+        }
+
+        if (vertices > 2)
+            return 0;
+
+        long cut = 0;
+        for (long e = 0; e < m; e++)
+            cut += in_cut(e);
+        return cut;
+    }
+
+    // Returns whether edge e crosses the cut found by the last trial.
+    bool in_cut(long e) {
+        const Multigraph::Edge& edge = graph.edges[e];
+        return find(edge.first) != find(edge.second);
+    }
+};
+
+
+// The smallest cut found by parallel_min_cut, and the first trial to find
+// it, or -1 should no trial have been run.
+struct MinCut {
+    long cut;
+    long trial;
+
+    MinCut() : cut(-1), trial(-1) {}
+
+    void consider(long cut, long trial) {
+        if (this->trial < 0 || cut < this->cut ||
+                (cut == this->cut && trial < this->trial)) {
+            this->cut = cut;
+            this->trial = trial;
+        }
+    }
+};
+
+
+// Runs trials of Karger's algorithm on `threads` threads, each with its own
+// ContractionEngine.
+//
+// Trial i draws from util::Rng::stream(seed, i), whichever thread runs it,
+// and trials are claimed in order from a shared counter, so the result
+// depends only on the seed. The best cut so far is shared through an atomic,
+// and once it reaches `lower_bound` no further trials are claimed: every
+// trial before the first to reach it has been claimed, and is completed.
+struct ParallelMinCut {
+    const Multigraph& graph;
+    const long trials;
+    const uint64_t seed;
+    const long lower_bound;
+    std::atomic<long> next;
+    std::atomic<long> best;
+    std::vector<MinCut> found;
+
+    ParallelMinCut(const Multigraph& graph, long trials, uint64_t seed,
+                   long lower_bound)
+        : graph(graph), trials(trials), seed(seed), lower_bound(lower_bound),
+          next(0), best(graph.edges.size()) {}
+
+    MinCut run(int threads) {
+        found.assign(threads, MinCut());
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.push_back(std::thread(&ParallelMinCut::work, this, t));
+        work(0);
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+
+        MinCut min_cut;
+        for (int t = 0; t < threads; t++) {
+            if (found[t].trial >= 0)
+                min_cut.consider(found[t].cut, found[t].trial);
+        }
+        return min_cut;
+    }
+
+    void work(int t) {
+        ContractionEngine engine(graph);
+        while (best.load() > lower_bound) {
+            const long i = next++;
+            if (i >= trials)
+                break;
+
+            util::Rng rng = util::Rng::stream(seed, i);
+            const long cut = engine.trial(rng);
+            found[t].consider(cut, i);
+
+            long current = best.load();
+            while (cut < current && !best.compare_exchange_weak(current, cut))
+                ;
+        }
+    }
+};
+
+
+// Runs up to `trials` trials of Karger's algorithm on `threads` threads,
+// and returns the smallest cut found, with the first trial to find it, which
+// may be replayed with a ContractionEngine and util::Rng::stream(seed, trial)
+// to recover the cut's edges.
+//
+// Stops early once a trial finds a cut of `lower_bound` edges, which must be
+// a lower bound on the min cut, for the result to be reproducible. A
+// connected graph's min cut is at least 1.
+MinCut parallel_min_cut(const Multigraph& graph, long trials, int threads,
+                        uint64_t seed = 1, long lower_bound = 1) {
+    return ParallelMinCut(graph, trials, seed, lower_bound).run(threads);
+}
+
+
+// Runs Karger and Stein's recursive contraction algorithm on a multigraph.
+//
+// A run contracts the graph to t = ceil(1 + n / sqrt(2)) vertices, twice,
+// independently, recursing on each contracted graph, down to graphs of 6
+// vertices, whose min cuts are found by trying every bipartition. Most of
+// the contractions are shared by many leaves, so a run takes O(n^2 log n)
+// time and finds a min cut with probability Ω(1 / log n), where a single
+// Karger trial succeeds with probability Ω(1 / n^2).
+//
+// Parallel edges are merged, as in a WeightedGraph, so a graph of t
+// vertices has fewer than t^2 / 2 edges. Contracting a uniformly random edge
+// of the multigraph is contracting an edge chosen with probability
+// proportional to its weight, which is done by contracting the edges in
+// order of exponentially distributed keys, with rates equal to their
+// weights. The keys are put in a heap, in linear time, and popped only
+// until t vertices remain, and the contracted graph's parallel edges are
+// merged by a radix sort, so that a contraction takes time linear in the
+// graph's size but for the edges it pops.
+//
+// Contracted graphs are stored one after another on `arena`, a stack of
+// edges that is popped as the recursion unwinds and reused from one run to
+// the next.
+//
+// See: Karger and Stein, "A new approach to the minimum cut problem" (1996).
+struct KargerStein {
+    int n;
+    std::vector<WeightedEdge> edges;
+    std::vector<WeightedEdge> arena;
+    std::vector<std::pair<double, long> > keys;
+    std::vector<int> parent;
+    std::vector<int> label;
+
+    explicit KargerStein(const Multigraph& graph)
+        : n(graph.n), edges(WeightedGraph(graph).edges), parent(graph.n),
+          label(graph.n) {}
+
+    // Returns the size of a *possible* min cut, or 0 should the graph be
+    // disconnected.
+    long run(util::Rng& rng) {
+        if (n < 2)
+            return 0;
+
+        arena = edges;
+        return recursive_contraction(0, n, rng);
+    }
+
+    long recursive_contraction(long first, int n, util::Rng& rng) {
+        if (n <= 6)
+            return min_cut_bruteforce(first, n);
+
+        const int t = std::ceil(1 + n / std::sqrt(2.0));
+        long min_cut = -1;
+        for (int branch = 0; branch < 2; branch++) {
+            const long top = arena.size();
+            if (!contract(first, n, t, rng)) {
+                arena.resize(top);
+                return 0;
+            }
+            long cut = recursive_contraction(top, t, rng);
+            if (min_cut < 0 || cut < min_cut)
+                min_cut = cut;
+            arena.resize(top);
+        }
+        return min_cut;
+    }
+
+    int find(int v) {
+        while (parent[v] != v) {
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    }
+
+    // Contracts the graph of n vertices whose edges are at the top of the
+    // arena, from `first`, to t vertices, and pushes the edges of the
+    // contracted graph, relabeled 0, 1, ..., t - 1. Returns false, pushing
+    // nothing, should the graph be disconnected.
+    bool contract(long first, int n, int t, util::Rng& rng) {
+        const long last = arena.size();
+        keys.clear();
+        for (long e = first; e < last; e++) {
+            double key = -std::log(1 - rng.uniform()) / arena[e].weight;
+            keys.push_back(std::make_pair(key, e));
+        }
+        const std::greater<std::pair<double, long> > later;
+        std::make_heap(keys.begin(), keys.end(), later);
+
+        for (int v = 0; v < n; v++)
+            parent[v] = v;
+
+        int vertices = n;
+        while (!keys.empty() && vertices > t) {
+            std::pop_heap(keys.begin(), keys.end(), later);
+            const long e = keys.back().second;
+            keys.pop_back();
+            int u = find(arena[e].u);
+            int v = find(arena[e].v);
+            if (u != v) {
+                parent[u] = v;
+                vertices--;
+            }
+        }
+        if (vertices > t)
+            return false;
+
+        for (int v = 0, next = 0; v < n; v++) {
+            if (parent[v] == v)
+                label[v] = next++;
+        }
+        for (long e = first; e < last; e++) {
+            int u = label[find(arena[e].u)];
+            int v = label[find(arena[e].v)];
+            if (u != v) {
+                arena.push_back(WeightedEdge(std::min(u, v), std::max(u, v),
+                                             arena[e].weight));
+            }
+        }
+        merge_parallel_edges(arena, last, t);
+        return true;
+    }
+
+    // Returns the min cut of the graph of n vertices whose edges are at the
+    // top of the arena, from `first`, by trying every bipartition.
+    long min_cut_bruteforce(long first, int n) const {
+        long min_cut = -1;
+        for (int side = 1; side < (1 << (n - 1)); side++) {
+            long cut = 0;
+            for (long e = first; e < (long) arena.size(); e++) {
+                if (((side >> arena[e].u) & 1) != ((side >> arena[e].v) & 1))
+                    cut += arena[e].weight;
+            }
+            if (min_cut < 0 || cut < min_cut)
+                min_cut = cut;
+        }
+        return std::max(min_cut, 0L);
+    }
+};
+
+
+// A cut of a weighted graph: its weight, and the vertices on one side.
+struct WeightedCut {
+    long weight;
+    std::vector<int> side;
+
+    WeightedCut() : weight(0) {}
+};
+
+
+// A max-priority queue of vertices keyed by integers no greater than
+// `max_key`, as an array of doubly linked lists, one per key. Increasing a
+// key takes O(1) time, and popping every vertex O(n + max_key) in all.
+struct BucketQueue {
+    std::vector<int> head;
+    std::vector<int> next;
+    std::vector<int> prev;
+    std::vector<long> key;
+    long top;
+
+    // Empties the queue, which may then hold vertices 0, 1, ..., n - 1.
+    void reset(int n, long max_key) {
+        head.assign(max_key + 1, -1);
+        next.resize(n);
+        prev.resize(n);
+        key.resize(n);
+        top = 0;
+    }
+
+    void push(int v) {
+        key[v] = 0;
+        link(v);
+    }
+
+    void increase(int v, long delta) {
+        unlink(v);
+        key[v] += delta;
+        link(v);
+        top = std::max(top, key[v]);
+    }
+
+    int pop() {
+        while (head[top] < 0)
+            top--;
+        int v = head[top];
+        unlink(v);
+        return v;
+    }
+
+    void link(int v) {
+        prev[v] = -1;
+        next[v] = head[key[v]];
+        if (next[v] >= 0)
+            prev[next[v]] = v;
+        head[key[v]] = v;
+    }
+
+    void unlink(int v) {
+        if (prev[v] >= 0)
+            next[prev[v]] = next[v];
+        else
+            head[key[v]] = next[v];
+        if (next[v] >= 0)
+            prev[next[v]] = prev[v];
+    }
+};
+
+
+// A max-priority queue of vertices as a binary heap, to which increasing a
+// key pushes a new entry, leaving the old one to be skipped when popped.
+struct HeapQueue {
+    std::priority_queue<std::pair<long, int> > heap;
+    std::vector<long> key;
+    std::vector<char> popped;
+
+    void reset(int n, long max_key) {
+        heap = std::priority_queue<std::pair<long, int> >();
+        key.resize(n);
+        popped.resize(n);
+    }
+
+    void push(int v) {
+        key[v] = 0;
+        popped[v] = false;
+        heap.push(std::make_pair(0L, v));
+    }
+
+    void increase(int v, long delta) {
+        key[v] += delta;
+        heap.push(std::make_pair(key[v], v));
+    }
+
+    int pop() {
+        for (;;) {
+            std::pair<long, int> top = heap.top();
+            heap.pop();
+            if (!popped[top.second] && top.first == key[top.second]) {
+                popped[top.second] = true;
+                return top.second;
+            }
+        }
+    }
+};
+
+
+// Finds a min cut of a weighted graph exactly, by Stoer and Wagner's
+// algorithm.
+//
+// Each of n - 1 phases orders the vertices by maximum adjacency: starting
+// anywhere, it repeatedly adds the vertex most heavily connected to those
+// already added. The last vertex, t, cut off from the rest, is a min cut
+// between t and the second to last vertex, s, which are then merged, as any
+// other cut keeps them together. The lightest of these cuts is a min cut.
+//
+// The graph is held in compressed sparse row form, and merged vertices are
+// chained together, so that a phase scans each edge once. Once half the
+// vertices have been merged, the graph is rebuilt, dropping self-loops and
+// merging parallel edges, so that later phases scan fewer edges.
+// A phase takes O(m + n + W) time with a BucketQueue, used while the total
+// weight W is within a small multiple of the graph's size, and
+// O(m log m) with a HeapQueue otherwise.
+//
+// See: Stoer and Wagner, "A simple min-cut algorithm" (1997).
+struct StoerWagner {
+    // The neighbors of vertex v, and the weights of the edges to them, are
+    // at targets[offsets[v], offsets[v + 1]) and the same range of weights.
+    int n;
+    std::vector<long> offsets;
+    std::vector<int> targets;
+    std::vector<long> weights;
+    long total_weight;
+    // Vertices merged since the graph was built form a union-find forest,
+    // and a chain, starting at the root, of next_merged links.
+    int remaining;
+    std::vector<int> parent;
+    std::vector<int> next_merged;
+    std::vector<int> last_merged;
+    // The original vertices merged into each root, as a chain of
+    // next_member links.
+    std::vector<int> first_member;
+    std::vector<int> last_member;
+    std::vector<int> next_member;
+    std::vector<char> added;
+    BucketQueue buckets;
+    HeapQueue heap;
+
+    explicit StoerWagner(const WeightedGraph& graph)
+        : next_member(graph.n, -1) {
+        std::vector<WeightedEdge> edges;
+        for (size_t e = 0; e < graph.edges.size(); e++) {
+            if (graph.edges[e].u != graph.edges[e].v)
+                edges.push_back(graph.edges[e]);
+        }
+        merge_parallel_edges(edges, 0, graph.n);
+
+        first_member.resize(graph.n);
+        for (int v = 0; v < graph.n; v++)
+            first_member[v] = v;
+        last_member = first_member;
+        build(graph.n, edges);
+    }
+
+    WeightedCut min_cut() {
+        WeightedCut best;
+        best.weight = -1;
+        while (remaining > 1) {
+            int s, t;
+            long cut;
+            if (total_weight <= 4 * (n + (long)targets.size()))
+                cut = phase(buckets, s, t);
             else
-                i++;
+                cut = phase(heap, s, t);
+
+            if (best.weight < 0 || cut < best.weight) {
+                best.weight = cut;
+                best.side.clear();
+                for (int v = first_member[t]; v >= 0; v = next_member[v])
+                    best.side.push_back(v);
+            }
+
+            merge(s, t);
+            if (remaining > 1 && remaining <= n / 2)
+                rebuild();
         }
+
+        best.weight = std::max(best.weight, 0L);
+        std::sort(best.side.begin(), best.side.end());
+        return best;
     }
 
-    return contracted_edges;
+    // Orders the remaining vertices by maximum adjacency, and returns the
+    // weight of the cut between the last, t, and the rest, setting s to the
+    // second to last.
+    template <typename Queue>
+    long phase(Queue& queue, int& s, int& t) {
+        queue.reset(n, total_weight);
+        for (int v = 0; v < n; v++) {
+            if (parent[v] == v) {
+                queue.push(v);
+                added[v] = false;
+            }
+        }
+
+        s = t = -1;
+        for (int i = 0; i < remaining; i++) {
+            int a = queue.pop();
+            added[a] = true;
+            s = t;
+            t = a;
+            for (int u = a; u >= 0; u = next_merged[u]) {
+                for (long e = offsets[u]; e < offsets[u + 1]; e++) {
+                    int v = find(targets[e]);
+                    if (!added[v])
+                        queue.increase(v, weights[e]);
+                }
+            }
+        }
+        return queue.key[t];
+    }
+
+    int find(int v) {
+        while (parent[v] != v) {
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    }
+
+    // Merges root t into root s.
+    void merge(int s, int t) {
+        parent[t] = s;
+        next_merged[last_merged[s]] = t;
+        last_merged[s] = last_merged[t];
+        next_member[last_member[s]] = first_member[t];
+        last_member[s] = last_member[t];
+        remaining--;
+    }
+
+    // Builds the graph of n vertices and `edges`, each u < v, without
+    // parallel edges.
+    void build(int n, const std::vector<WeightedEdge>& edges) {
+        this->n = n;
+        offsets.assign(n + 1, 0);
+        total_weight = 0;
+        for (size_t e = 0; e < edges.size(); e++) {
+            offsets[edges[e].u + 1]++;
+            offsets[edges[e].v + 1]++;
+            total_weight += edges[e].weight;
+        }
+        for (int v = 0; v < n; v++)
+            offsets[v + 1] += offsets[v];
+
+        targets.resize(offsets[n]);
+        weights.resize(offsets[n]);
+        std::vector<long> position(offsets.begin(), offsets.end() - 1);
+        for (size_t e = 0; e < edges.size(); e++) {
+            const WeightedEdge& edge = edges[e];
+            targets[position[edge.u]] = edge.v;
+            weights[position[edge.u]++] = edge.weight;
+            targets[position[edge.v]] = edge.u;
+            weights[position[edge.v]++] = edge.weight;
+        }
+
+        remaining = n;
+        parent.resize(n);
+        last_merged.resize(n);
+        for (int v = 0; v < n; v++)
+            parent[v] = last_merged[v] = v;
+        next_merged.assign(n, -1);
+        added.resize(n);
+    }
+
+    // Rebuilds the graph over the remaining vertices.
+    void rebuild() {
+        std::vector<int> label(n, -1);
+        std::vector<int> first, last;
+        for (int v = 0; v < n; v++) {
+            if (parent[v] == v) {
+                label[v] = first.size();
+                first.push_back(first_member[v]);
+                last.push_back(last_member[v]);
+            }
+        }
+
+        std::vector<WeightedEdge> edges;
+        for (int u = 0; u < n; u++) {
+            int lu = label[find(u)];
+            for (long e = offsets[u]; e < offsets[u + 1]; e++) {
+                int lv = label[find(targets[e])];
+                if (lu < lv)
+                    edges.push_back(WeightedEdge(lu, lv, weights[e]));
+            }
+        }
+        merge_parallel_edges(edges, 0, first.size());
+
+        first_member.swap(first);
+        last_member.swap(last);
+        build(first_member.size(), edges);
+    }
+};
+
+
+// Returns a min cut of a weighted graph, found by Stoer and Wagner's
+// algorithm in O(n (m + n + W)) time if its total weight W is small, and
+// O(nm log m) otherwise, one phase taking the time given at StoerWagner.
+WeightedCut stoer_wagner(const WeightedGraph& graph) {
+    return StoerWagner(graph).min_cut();
 }
 
 
-void test_randomized_contraction() {
-    const std::string adj_list =
-         "1 19 15 36 23 18 39\n"
-         "2 36 23 4 18 26 9\n"
-         "3 35 6 16 11\n"
-         "4 23 2 18 24\n"
-         "5 14 8 29 21\n"
-         "6 34 35 3 16\n"
-         "7 30 33 38 28\n"
-         "8 12 14 5 29 31\n"
-         "9 39 13 20 10 17 2\n"
-         "10 9 20 12 14 29\n"
-         "11 3 16 30 33 26\n"
-         "12 20 10 14 8\n"
-         "13 24 39 9 20\n"
-         "14 10 12 8 5\n"
-         "15 26 19 1 36\n"
-         "16 6 3 11 30 17 35 32\n"
-         "17 38 28 32 40 9 16\n"
-         "18 2 4 24 39 1\n"
-         "19 27 26 15 1\n"
-         "20 13 9 10 12\n"
-         "21 5 29 25 37\n"
-         "22 32 40 34 35\n"
-         "23 1 36 2 4\n"
-         "24 4 18 39 13\n"
-         "25 29 21 37 31\n"
-         "26 31 27 19 15 11 2\n"
-         "27 37 31 26 19 29\n"
-         "28 7 38 17 32\n"
-         "29 8 5 21 25 10 27\n"
-         "30 16 11 33 7 37\n"
-         "31 25 37 27 26 8\n"
-         "32 28 17 40 22 16\n"
-         "33 11 30 7 38\n"
-         "34 40 22 35 6\n"
-         "35 22 34 6 3 16\n"
-         "36 15 1 23 2\n"
-         "37 21 25 31 27 30\n"
-         "38 33 7 28 17 40\n"
-         "39 18 24 13 9 1\n"
-         "40 17 32 22 34 38\n";
+// Relabels `vertices` as 0, 1, ..., n - 1, in the order given, and returns
+// the multigraph of `edges` over them.
+Multigraph relabel(const std::vector<Vertex>& vertices,
+                   const std::vector<Edge>& edges) {
+    std::map<Vertex, int> ids;
+    for (size_t v = 0; v < vertices.size(); v++)
+        ids[vertices[v]] = v;
 
-    std::vector<Vertex> vertices;
-    std::vector<Edge> edges;
+    Multigraph graph(vertices.size());
+    for (size_t e = 0; e < edges.size(); e++) {
+        graph.edges.push_back(Multigraph::Edge(ids[edges[e].first],
+                                               ids[edges[e].second]));
+    }
+    return graph;
+}
+
+
+// Given an undirected graph consisting of n vertices and m edges,
+// returns a *possible* min cut after n - 1 edge contractions, where edges are
+// chosen uniformly at random (Karger's algorithm).
+//
+// This relabels the graph and runs one trial of a ContractionEngine on it;
+// to run many trials, use the engine directly.
+std::vector<Edge> randomized_contraction(const std::vector<Vertex>& vertices,
+                                         const std::vector<Edge>& edges) {
+    Multigraph graph = relabel(vertices, edges);
+    ContractionEngine engine(graph);
+    util::Rng rng(rand());
 
+    std::vector<Edge> cut;
+    if (engine.trial(rng) > 0) {
+        for (size_t e = 0; e < edges.size(); e++) {
+            if (engine.in_cut(e))
+                cut.push_back(edges[e]);
+        }
+    }
+    return cut;
+}
+
+
+// Parses an adjacency list, each row of which lists a vertex followed by its
+// neighbors, and appends each vertex to `vertices`, and each edge, once, to
+// `edges`. Vertices must be numbered.
+void parse_adjacency_list(const std::string& adj_list,
+                          std::vector<Vertex>& vertices,
+                          std::vector<Edge>& edges) {
     std::vector<std::string> rows = util::split(adj_list, '\n');
     typedef std::vector<std::string>::iterator Iter;
 
@@ -145,25 +844,347 @@ void test_randomized_contraction() {
             edges.push_back(Edge(vertex, endpoint));
         }
     }
+}
+
+
+// The graph from test_randomized_contraction, whose min cut is 3.
+const std::string test_adj_list =
+    "1 19 15 36 23 18 39\n"
+    "2 36 23 4 18 26 9\n"
+    "3 35 6 16 11\n"
+    "4 23 2 18 24\n"
+    "5 14 8 29 21\n"
+    "6 34 35 3 16\n"
+    "7 30 33 38 28\n"
+    "8 12 14 5 29 31\n"
+    "9 39 13 20 10 17 2\n"
+    "10 9 20 12 14 29\n"
+    "11 3 16 30 33 26\n"
+    "12 20 10 14 8\n"
+    "13 24 39 9 20\n"
+    "14 10 12 8 5\n"
+    "15 26 19 1 36\n"
+    "16 6 3 11 30 17 35 32\n"
+    "17 38 28 32 40 9 16\n"
+    "18 2 4 24 39 1\n"
+    "19 27 26 15 1\n"
+    "20 13 9 10 12\n"
+    "21 5 29 25 37\n"
+    "22 32 40 34 35\n"
+    "23 1 36 2 4\n"
+    "24 4 18 39 13\n"
+    "25 29 21 37 31\n"
+    "26 31 27 19 15 11 2\n"
+    "27 37 31 26 19 29\n"
+    "28 7 38 17 32\n"
+    "29 8 5 21 25 10 27\n"
+    "30 16 11 33 7 37\n"
+    "31 25 37 27 26 8\n"
+    "32 28 17 40 22 16\n"
+    "33 11 30 7 38\n"
+    "34 40 22 35 6\n"
+    "35 22 34 6 3 16\n"
+    "36 15 1 23 2\n"
+    "37 21 25 31 27 30\n"
+    "38 33 7 28 17 40\n"
+    "39 18 24 13 9 1\n"
+    "40 17 32 22 34 38\n";
+
+
+// Returns the graph of test_adj_list.
+graph::Graph test_graph() {
+    graph::ParseOptions options;
+    options.base = 1;
+    graph::Graph result;
+    bool ok = graph::parse(test_adj_list, options, graph::AdjacencyList(),
+                           result);
+    assert(ok);
+    return result;
+}
+
+
+// Returns the min cut of a small graph by trying every bipartition.
+long min_cut_bruteforce(const Multigraph& graph) {
+    long min_cut = graph.edges.size();
+    // Vertex n - 1 is always on the 0 side.
+    for (long side = 1; side < (1L << (graph.n - 1)); side++) {
+        long cut = 0;
+        for (size_t e = 0; e < graph.edges.size(); e++) {
+            const Multigraph::Edge& edge = graph.edges[e];
+            cut += ((side >> edge.first) & 1) != ((side >> edge.second) & 1);
+        }
+        min_cut = std::min(min_cut, cut);
+    }
+    return min_cut;
+}
+
+
+// Returns a random multigraph of n vertices and m edges, without
+// self-loops.
+Multigraph random_multigraph(int n, int m, util::Rng& rng) {
+    Multigraph graph(n);
+    while ((int) graph.edges.size() < m) {
+        int u = rng.below(n), v = rng.below(n);
+        if (u != v)
+            graph.edges.push_back(Multigraph::Edge(u, v));
+    }
+    return graph;
+}
+
+
+void test_contraction_engine() {
+    util::Rng rng(1);
+
+    for (int trial = 0; trial < 200; trial++) {
+        const int n = 2 + rng.below(9);
+        Multigraph graph = random_multigraph(n, rng.below(4 * n), rng);
+
+        ContractionEngine engine(graph);
+        long min_cut = graph.edges.size();
+        for (int i = 0; i < 20 * n * n; i++)
+            min_cut = std::min(min_cut, engine.trial(rng));
+        assert(min_cut == min_cut_bruteforce(graph));
+    }
+}
+
+
+void test_karger_stein() {
+    util::Rng rng(2);
+
+    for (int trial = 0; trial < 200; trial++) {
+        const int n = 2 + rng.below(11);
+        Multigraph graph = random_multigraph(n, rng.below(4 * n), rng);
+
+        KargerStein karger_stein(graph);
+        long min_cut = graph.edges.size();
+        for (int i = 0; i < 20; i++)
+            min_cut = std::min(min_cut, karger_stein.run(rng));
+        assert(min_cut == min_cut_bruteforce(graph));
+    }
+
+    Multigraph graph(test_graph());
+    KargerStein karger_stein(graph);
+    long min_cut = graph.edges.size();
+    const int runs = std::pow(std::log(graph.n), 2);
+    for (int i = 0; i < runs; i++)
+        min_cut = std::min(min_cut, karger_stein.run(rng));
+    assert(min_cut == 3);
+}
+
+
+// Returns the weight of the edges between `side` and the other vertices.
+long cut_weight(const WeightedGraph& graph, const std::vector<int>& side) {
+    std::vector<char> in_side(graph.n, false);
+    for (size_t i = 0; i < side.size(); i++)
+        in_side[side[i]] = true;
+
+    long weight = 0;
+    for (size_t e = 0; e < graph.edges.size(); e++) {
+        const WeightedEdge& edge = graph.edges[e];
+        if (in_side[edge.u] != in_side[edge.v])
+            weight += edge.weight;
+    }
+    return weight;
+}
+
+
+void test_stoer_wagner() {
+    util::Rng rng(3);
+
+    for (int trial = 0; trial < 500; trial++) {
+        const int n = 2 + rng.below(11);
+        Multigraph multigraph = random_multigraph(n, rng.below(4 * n), rng);
+        const long min_cut = min_cut_bruteforce(multigraph);
+
+        // Heavy edges take the HeapQueue, rather than the BucketQueue.
+        for (long scale = 1; scale <= 1000000000L; scale *= 1000000000L) {
+            WeightedGraph graph(multigraph);
+            for (size_t e = 0; e < graph.edges.size(); e++)
+                graph.edges[e].weight *= scale;
+
+            WeightedCut cut = stoer_wagner(graph);
+            assert(cut.weight == scale * min_cut);
+            assert(cut.side.size() > 0 && (int) cut.side.size() < n);
+            assert(cut_weight(graph, cut.side) == cut.weight);
+        }
+    }
+
+    WeightedGraph graph(test_graph());
+    WeightedCut cut = stoer_wagner(graph);
+    assert(cut.weight == 3 && cut_weight(graph, cut.side) == 3);
+
+    // Two copies of the graph, joined by a light edge.
+    graph.n *= 2;
+    for (long e = 0, m = graph.edges.size(); e < m; e++) {
+        WeightedEdge edge = graph.edges[e];
+        graph.edges.push_back(WeightedEdge(edge.u + 40, edge.v + 40,
+                                           edge.weight));
+    }
+    graph.edges.push_back(WeightedEdge(0, 40, 2));
+    cut = stoer_wagner(graph);
+    assert(cut.weight == 2 && cut.side.size() == 40);
+}
 
-    std::vector<Edge> min_cut(edges);
-    const int n = vertices.size();
+
+void test_randomized_contraction() {
+    std::vector<Vertex> vertices;
+    std::vector<Edge> edges;
+    parse_adjacency_list(test_adj_list, vertices, edges);
+    Multigraph graph(test_graph());
+    assert(graph.n == (int) vertices.size()
+           && graph.edges.size() == edges.size());
+
+    const int n = graph.n;
     const int trials = std::log(n) * std::pow(n, 2);
-    for (int i = 0; i < trials; i++) {
-        std::vector<Edge> possible_min_cut = randomized_contraction(vertices,
-                                                                    edges);
-        if (possible_min_cut.size() < min_cut.size()) {
-            min_cut = possible_min_cut;
+    const uint64_t seed = rand();
+    MinCut min_cut = parallel_min_cut(graph, trials, 4, seed);
+    assert(min_cut.cut == 3);
+
+    // The result depends only on the seed, with or without stopping early.
+    for (int threads = 1; threads <= 3; threads++) {
+        MinCut other = parallel_min_cut(graph, trials, threads, seed);
+        assert(other.cut == min_cut.cut && other.trial == min_cut.trial);
+    }
+    MinCut early = parallel_min_cut(graph, trials, 4, seed, 3);
+    assert(early.cut == 3 && early.trial == min_cut.trial);
+
+    // The first trial to find the min cut, replayed.
+    ContractionEngine engine(graph);
+    for (long i = 0; i < early.trial; i++) {
+        util::Rng rng = util::Rng::stream(seed, i);
+        assert(engine.trial(rng) > 3);
+    }
+    util::Rng rng = util::Rng::stream(seed, early.trial);
+    assert(engine.trial(rng) == 3);
+
+    // Every cut has at least 3 edges, each between a vertex on one side and
+    // a vertex on the other.
+    for (int i = 0; i < 10; i++) {
+        std::vector<Edge> cut = randomized_contraction(vertices, edges);
+        assert(cut.size() >= 3);
+
+        // Flood one side from an endpoint of the cut, without crossing it.
+        std::set<Vertex> side;
+        side.insert(cut[0].first);
+        for (bool grew = true; grew; ) {
+            grew = false;
+            for (size_t e = 0; e < edges.size(); e++) {
+                const Edge& edge = edges[e];
+                if (std::count(cut.begin(), cut.end(), edge))
+                    continue;
+                if (side.count(edge.first) != side.count(edge.second)) {
+                    side.insert(edge.first);
+                    side.insert(edge.second);
+                    grew = true;
+                }
+            }
         }
+        for (size_t e = 0; e < cut.size(); e++)
+            assert(side.count(cut[e].first) != side.count(cut[e].second));
+    }
+}
+
+
+// Returns a graph of two random halves of n / 2 vertices and m / 2 edges
+// each, joined by `cut` edges, which are its min cut if the halves are
+// dense enough.
+Multigraph planted_cut_graph(int n, int m, int cut, util::Rng& rng) {
+    Multigraph graph = random_multigraph(n / 2, m / 2, rng);
+    Multigraph other = random_multigraph(n - n / 2, m / 2, rng);
+
+    graph.n = n;
+    for (size_t e = 0; e < other.edges.size(); e++) {
+        graph.edges.push_back(Multigraph::Edge(other.edges[e].first + n / 2,
+                                               other.edges[e].second + n / 2));
     }
+    for (int e = 0; e < cut; e++) {
+        graph.edges.push_back(Multigraph::Edge(rng.below(n / 2),
+                                               n / 2 + rng.below(n - n / 2)));
+    }
+    return graph;
+}
+
+
+void benchmark_min_cut(int n) {
+    util::Rng rng(1);
+    Multigraph graph = planted_cut_graph(n, 20 * n, 3, rng);
+    std::cout << "n = " << n << ", m = " << graph.edges.size()
+              << ", min cut = 3" << std::endl;
+
+    const int runs = 20;
+    util::Timer timer;
+    ContractionEngine engine(graph);
+    int found = 0;
+    for (int i = 0; i < runs; i++)
+        found += engine.trial(rng) == 3;
+    std::cout << "  Karger: " << timer.seconds() / runs << " s per trial, "
+              << found << "/" << runs << " found the min cut" << std::endl;
+
+    timer = util::Timer();
+    KargerStein karger_stein(graph);
+    found = 0;
+    for (int i = 0; i < runs; i++)
+        found += karger_stein.run(rng) == 3;
+    std::cout << "  Karger-Stein: " << timer.seconds() / runs
+              << " s per run, " << found << "/" << runs
+              << " found the min cut" << std::endl;
+
+    const int trials = 1000;
+    const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        timer = util::Timer();
+        parallel_min_cut(graph, trials, threads);
+        double all = timer.seconds();
+
+        timer = util::Timer();
+        MinCut early = parallel_min_cut(graph, trials, threads, 1, 3);
+        std::cout << "  Karger, " << threads << " threads: " << all
+                  << " s for " << trials << " trials, " << timer.seconds()
+                  << " s stopping at the min cut (trial " << early.trial
+                  << ")" << std::endl;
+    }
+}
+
+
+// Compares Stoer-Wagner with as many Karger trials as find the min cut with
+// probability 0.99, n (n - 1) / 2 ln 100 of them, whose time is estimated
+// from that of 20 trials.
+void benchmark_stoer_wagner() {
+    util::Rng rng(1);
+    for (int n = 250; n <= 4000; n *= 4) {
+        Multigraph multigraph = planted_cut_graph(n, 10 * n, 3, rng);
+        WeightedGraph graph(multigraph);
 
-    assert(min_cut.size() == 3);
+        util::Timer timer;
+        WeightedCut cut = stoer_wagner(graph);
+        double stoer_wagner_time = timer.seconds();
+        assert(cut.weight == 3);
+
+        ContractionEngine engine(multigraph);
+        timer = util::Timer();
+        for (int i = 0; i < 20; i++)
+            engine.trial(rng);
+        const double trials = 0.5 * n * (n - 1) * std::log(100.0);
+        std::cout << "n = " << n << ", m = " << 10 * n << ": Stoer-Wagner "
+                  << stoer_wagner_time << " s, Karger " << trials << " trials "
+                  << timer.seconds() / 20 * trials << " s (estimated)"
+                  << std::endl;
+    }
 }
 
 
 int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        benchmark_min_cut(1000);
+        benchmark_stoer_wagner();
+        return 0;
+    }
+
     srand(time(NULL));
+    test_contraction_engine();
     test_randomized_contraction();
+    test_karger_stein();
+    test_stoer_wagner();
     std::cout << "Tests passed." << std::endl;
     return 0;
 }
@@ -0,0 +1,396 @@
+// Copyright (c) 2012 Gregg Gajic <gregg.gajic@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Streaming approximate quantiles: KLL and t-digest sketches
+//
+// Unlike exact selection, which needs the entire input in memory, a sketch
+// summarizes a stream of unbounded length in bounded memory, and sketches
+// built independently (e.g. on different threads) can be merged.
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "selection.h"
+#include "util.h"
+
+
+namespace selection = algorithms::selection;
+namespace util = algorithms::util;
+
+
+// KLL sketch (Karnin, Lang and Liberty)
+//
+// Items are kept in a hierarchy of compactors, where each item at level h
+// stands for 2^h items of the stream. When a level fills, it is sorted and
+// either its odd or even items, chosen at random, are promoted to the level
+// above, while the others are discarded. Level capacities shrink
+// geometrically by 2/3 from k at the top level, so at most about 3k items
+// are retained regardless of the length of the stream. Updates take O(1)
+// amortized time for a fixed k.
+//
+// With k = 200, the rank of quantile(q) is within about 0.0165n of q * n with
+// 99% probability.
+//
+// See: http://arxiv.org/abs/1603.05346
+struct KllSketch {
+    int k;
+    long n;
+    long size;
+    long max_size;
+    std::vector<std::vector<double> > levels;
+    util::Rng rng;
+
+    explicit KllSketch(int k = 200, uint64_t seed = 1)
+        : k(k), n(0), size(0), max_size(0), rng(seed) {
+        grow();
+    }
+
+    // Returns the capacity of level h.
+    long capacity(int h) const {
+        int depth = levels.size() - h - 1;
+        return std::max(2L, long(std::ceil(k * std::pow(2.0 / 3, depth))));
+    }
+
+    void grow() {
+        levels.push_back(std::vector<double>());
+        max_size = 0;
+        for (size_t h = 0; h < levels.size(); h++)
+            max_size += capacity(h);
+    }
+
+    void update(double x) {
+        levels[0].push_back(x);
+        n++;
+        size++;
+        if (size >= max_size)
+            compress();
+    }
+
+    // Compacts full levels, lowest first, until fewer than max_size items
+    // are retained.
+    void compress() {
+        for (size_t h = 0; h < levels.size(); h++) {
+            if (levels[h].size() < (size_t) capacity(h))
+                continue;
+            if (h + 1 == levels.size())
+                grow();
+
+            std::vector<double>& level = levels[h];
+            std::sort(level.begin(), level.end());
+
+            // An odd item out stays behind.
+            double leftover = level.back();
+            const bool odd = level.size() % 2 == 1;
+            if (odd)
+                level.pop_back();
+
+            for (size_t i = rng() & 1; i < level.size(); i += 2)
+                levels[h + 1].push_back(level[i]);
+            size -= level.size() / 2;
+            level.clear();
+            if (odd)
+                level.push_back(leftover);
+
+            if (size < max_size)
+                break;
+        }
+    }
+
+    // Merges the items summarized by `other` into this sketch.
+    void merge(const KllSketch& other) {
+        while (levels.size() < other.levels.size())
+            grow();
+        for (size_t h = 0; h < other.levels.size(); h++) {
+            levels[h].insert(levels[h].end(), other.levels[h].begin(),
+                             other.levels[h].end());
+        }
+        n += other.n;
+        size += other.size;
+        while (size >= max_size)
+            compress();
+    }
+
+    // Returns an item whose rank approximates q * n, for q in [0, 1].
+    double quantile(double q) const {
+        std::vector<std::pair<double, long> > weighted;
+        weighted.reserve(size);
+        for (size_t h = 0; h < levels.size(); h++) {
+            for (size_t i = 0; i < levels[h].size(); i++)
+                weighted.push_back(std::make_pair(levels[h][i], 1L << h));
+        }
+        if (weighted.empty())
+            return std::numeric_limits<double>::quiet_NaN();
+        std::sort(weighted.begin(), weighted.end());
+
+        long cumulative_weight = 0;
+        for (size_t i = 0; i < weighted.size(); i++) {
+            cumulative_weight += weighted[i].second;
+            if (cumulative_weight > q * n)
+                return weighted[i].first;
+        }
+        return weighted.back().first;
+    }
+};
+
+
+// Merging t-digest (Dunning and Ertl)
+//
+// Summarizes the stream as a sorted list of centroids (mean, weight), where
+// the weight a centroid may reach is limited by the arcsine scale function
+// k(q) = compression / 2pi * asin(2q - 1): centroids near the median may
+// absorb many items, while those in the tails stay small. Incoming items are
+// buffered, and merged into the centroids once the buffer fills, so updates
+// take O(1) amortized time for a fixed compression. At most `compression`
+// centroids are retained.
+//
+// A t-digest provides no worst-case bound, but its rank error is
+// proportional to q(1 - q), thus is far smaller in the tails than that of a
+// KLL sketch of similar size. With compression = 100, the rank of
+// quantile(q) is typically within 0.002n of q * n for q <= 0.01 or
+// q >= 0.99, and within 0.01n for any q.
+//
+// See: http://arxiv.org/abs/1902.04023
+struct TDigest {
+    struct Centroid {
+        double mean;
+        double weight;
+
+        Centroid(double mean, double weight) : mean(mean), weight(weight) {}
+
+        bool operator<(const Centroid& other) const {
+            return mean < other.mean;
+        }
+    };
+
+    double compression;
+    double total_weight;
+    double min;
+    double max;
+    std::vector<Centroid> centroids;
+    std::vector<Centroid> buffer;
+
+    explicit TDigest(double compression = 100)
+        : compression(compression),
+          total_weight(0),
+          min(std::numeric_limits<double>::infinity()),
+          max(-std::numeric_limits<double>::infinity()) {}
+
+    // Returns the scale function k(q).
+    double k(double q) const {
+        return compression / (2 * pi()) * std::asin(2 * q - 1);
+    }
+
+    // Returns the inverse of the scale function, q(k).
+    double q(double k) const {
+        if (k >= compression / 4)
+            return 1;
+        return (std::sin(k * 2 * pi() / compression) + 1) / 2;
+    }
+
+    static double pi() {
+        return 3.14159265358979323846;
+    }
+
+    void update(double x, double weight = 1) {
+        buffer.push_back(Centroid(x, weight));
+        total_weight += weight;
+        min = std::min(min, x);
+        max = std::max(max, x);
+        if (buffer.size() >= 5 * compression)
+            flush();
+    }
+
+    // Merges the buffered items into the centroids.
+    void flush() {
+        if (buffer.empty())
+            return;
+
+        buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+        std::sort(buffer.begin(), buffer.end());
+        centroids.clear();
+
+        Centroid current = buffer[0];
+        double weight_so_far = 0;
+        double weight_limit = total_weight * q(k(0) + 1);
+        for (size_t i = 1; i < buffer.size(); i++) {
+            double proposed_weight = current.weight + buffer[i].weight;
+            if (weight_so_far + proposed_weight <= weight_limit) {
+                current.mean += (buffer[i].mean - current.mean)
+                                * buffer[i].weight / proposed_weight;
+                current.weight = proposed_weight;
+            }
+            else {
+                weight_so_far += current.weight;
+                centroids.push_back(current);
+                weight_limit = total_weight
+                               * q(k(weight_so_far / total_weight) + 1);
+                current = buffer[i];
+            }
+        }
+        centroids.push_back(current);
+        buffer.clear();
+    }
+
+    // Merges the items summarized by `other` into this digest.
+    void merge(const TDigest& other) {
+        buffer.insert(buffer.end(), other.centroids.begin(),
+                      other.centroids.end());
+        buffer.insert(buffer.end(), other.buffer.begin(),
+                      other.buffer.end());
+        total_weight += other.total_weight;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        flush();
+    }
+
+    // Returns an estimate of the item with rank q * n, for q in [0, 1], by
+    // interpolating between the means of the centroids either side of it.
+    double quantile(double q) {
+        flush();
+        if (centroids.empty())
+            return std::numeric_limits<double>::quiet_NaN();
+
+        // Each centroid's mean is taken to lie at the middle of its weight.
+        const double index = q * total_weight;
+        double weight_so_far = centroids[0].weight / 2;
+        if (index <= weight_so_far) {
+            return min + (centroids[0].mean - min) * index / weight_so_far;
+        }
+
+        for (size_t i = 0; i + 1 < centroids.size(); i++) {
+            double gap = (centroids[i].weight + centroids[i + 1].weight) / 2;
+            if (weight_so_far + gap > index) {
+                double t = (index - weight_so_far) / gap;
+                return centroids[i].mean
+                       + t * (centroids[i + 1].mean - centroids[i].mean);
+            }
+            weight_so_far += gap;
+        }
+
+        const Centroid& last = centroids.back();
+        double t = std::min(1.0, (index - weight_so_far) / (last.weight / 2));
+        return last.mean + t * (max - last.mean);
+    }
+};
+
+
+// Asserts that `estimate` lies between the exact ((q - epsilon) * n)th and
+// ((q + epsilon) * n)th smallest items in `input`, found using
+// selection::multi_select.
+void assert_rank_within(const std::vector<double>& input, double q,
+                        double epsilon, double estimate) {
+    const long n = input.size();
+    long ranks[] = {std::max(0L, long((q - epsilon) * n)),
+                    std::min(n - 1, long((q + epsilon) * n))};
+    double bounds[2];
+
+    std::vector<double> copy(input);
+    selection::multi_select(ranks, ranks + 2, copy.begin(), copy.end(),
+                            bounds);
+    assert(bounds[0] <= estimate && estimate <= bounds[1]);
+}
+
+
+template <typename Sketch>
+void build_sketch(Sketch* sketch, std::vector<double>::const_iterator first,
+                  std::vector<double>::const_iterator last) {
+    for (; first != last; first++)
+        sketch->update(*first);
+}
+
+
+void test_sketches(const std::vector<double>& input) {
+    const double quantiles[] = {0.001, 0.01, 0.05, 0.25, 0.5, 0.75, 0.95,
+                                0.99, 0.999};
+    const int num_quantiles = sizeof quantiles / sizeof quantiles[0];
+
+    // Build one sketch of each kind per shard, each on its own thread, then
+    // merge them.
+    const int shards = 4;
+    std::vector<KllSketch> klls;
+    std::vector<TDigest> digests(shards);
+    for (int shard = 0; shard < shards; shard++)
+        klls.push_back(KllSketch(200, shard + 1));
+
+    std::vector<std::thread> threads;
+    for (int shard = 0; shard < shards; shard++) {
+        std::vector<double>::const_iterator first, last;
+        first = input.begin() + input.size() * shard / shards;
+        last = input.begin() + input.size() * (shard + 1) / shards;
+        threads.push_back(std::thread(build_sketch<KllSketch>,
+                                      &klls[shard], first, last));
+        threads.push_back(std::thread(build_sketch<TDigest>,
+                                      &digests[shard], first, last));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    for (int shard = 1; shard < shards; shard++) {
+        klls[0].merge(klls[shard]);
+        digests[0].merge(digests[shard]);
+    }
+
+    KllSketch& kll = klls[0];
+    TDigest& digest = digests[0];
+    assert(kll.n == (long) input.size());
+    assert(kll.size <= 3 * kll.k + 2 * (long) kll.levels.size());
+    assert(digest.total_weight == input.size());
+    assert(digest.centroids.size() <= digest.compression);
+
+    for (int i = 0; i < num_quantiles; i++) {
+        const double q = quantiles[i];
+        assert_rank_within(input, q, 0.0165, kll.quantile(q));
+
+        const bool tail = q <= 0.01 || q >= 0.99;
+        assert_rank_within(input, q, tail ? 0.002 : 0.01,
+                           digest.quantile(q));
+    }
+}
+
+
+int main(int argc, char** argv) {
+    const int n = 1000000;
+    util::Rng rng(42);
+
+    std::vector<double> uniform(n);
+    for (int i = 0; i < n; i++)
+        uniform[i] = rng.uniform();
+    test_sketches(uniform);
+
+    // Heavy-tailed (Pareto) input.
+    std::vector<double> pareto(n);
+    for (int i = 0; i < n; i++)
+        pareto[i] = 1 / std::sqrt(1 - rng.uniform());
+    test_sketches(pareto);
+
+    // Sorted input, the worst case for many sketches.
+    std::sort(pareto.begin(), pareto.end());
+    test_sketches(pareto);
+
+    std::cout << "Tests passed." << std::endl;
+    return 0;
+}
@@ -66,6 +66,7 @@ int main(int argc, char** argv) {
         test_quicksort(*i, quicksort::Last());
         test_quicksort(*i, quicksort::Random());
         test_quicksort(*i, quicksort::MedianOfThree());
+        test_quicksort(*i, quicksort::Ninther());
     }
 
     std::cout << "Tests passed." << std::endl;
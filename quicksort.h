@@ -24,6 +24,7 @@
 #define ALGORITHMS_QUICKSORT_H
 
 #include <algorithm>
+#include <iterator>
 
 #include "util.h"
 
@@ -92,6 +93,45 @@ struct MedianOfThree {
 };
 
 
+struct Ninther {
+    // Given a pair of iterators, first and last, corresponding to items in
+    // range [first, last), returns an iterator to Tukey's "ninther": the
+    // median of the medians of three evenly spaced triples of items.
+    //
+    // Unlike MedianOfThree, the sampled items are not reordered. Ranges of
+    // fewer than 9 items fall back to MedianOfThree.
+    template<typename RandomAccessIterator>
+    RandomAccessIterator operator()(RandomAccessIterator first,
+                                    RandomAccessIterator last) {
+        if (last - first < 9)
+            return MedianOfThree()(first, last);
+
+        typename std::iterator_traits<RandomAccessIterator>::difference_type
+            step = (last - first) / 9;
+        RandomAccessIterator a = first + step / 2;
+
+        return median(median(a, a + step, a + 2 * step),
+                      median(a + 3 * step, a + 4 * step, a + 5 * step),
+                      median(a + 6 * step, a + 7 * step, a + 8 * step));
+    }
+
+    // Returns whichever of a, b, and c refers to the median of *a, *b, *c.
+    template<typename RandomAccessIterator>
+    static RandomAccessIterator median(RandomAccessIterator a,
+                                       RandomAccessIterator b,
+                                       RandomAccessIterator c) {
+        if (*a < *b) {
+            if (*b < *c)
+                return b;
+            return *a < *c ? c : a;
+        }
+        if (*a < *c)
+            return a;
+        return *b < *c ? c : b;
+    }
+};
+
+
 struct Random {
     // Given a pair of iterators, first and last, corresponding to items in
     // range [first, last), returns an iterator to an item in
@@ -0,0 +1,460 @@
+// Copyright (c) 2012 Gregg Gajic <gregg.gajic@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Reservoir sampling: uniform and weighted random samples of streams of
+// unknown length.
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "uniformity.h"
+#include "util.h"
+
+
+namespace uniformity = algorithms::uniformity;
+namespace util = algorithms::util;
+
+
+// Maintains a sample of k items chosen uniformly at random, without
+// replacement, from a stream of items (Li's Algorithm L).
+//
+// Rather than drawing a random number for every item, as Algorithm R does,
+// the number of items to skip before the next one enters the sample is drawn
+// from its geometric distribution, so only O(k log(n / k)) random numbers
+// are drawn for a stream of n items.
+//
+// See: http://dl.acm.org/citation.cfm?id=198435
+template <typename T>
+struct ReservoirSampler {
+    long k;
+    // The number of items pushed so far.
+    long count;
+    // The index in the stream of the next item to enter the sample.
+    long next;
+    // The largest of the k smallest of `count` random keys in [0, 1), one
+    // per item, whose items form the sample.
+    double w;
+    std::vector<T> sample;
+    util::Rng rng;
+
+    ReservoirSampler(long k, uint64_t seed)
+        : k(k), count(0), next(LONG_MAX), w(1), rng(seed) {
+        sample.reserve(k);
+    }
+
+    // Returns a real number in range (0, 1] chosen uniformly at random.
+    double uniform() {
+        return 1 - rng.uniform();
+    }
+
+    // Lowers w to the largest key of a sample that has just gained an item.
+    void lower_w() {
+        w *= std::exp(std::log(uniform()) / k);
+    }
+
+    // Draws the next item to enter the sample, following `count` items.
+    void skip() {
+        double skipped = std::floor(std::log(uniform()) / std::log1p(-w));
+        next = skipped < LONG_MAX - count ? count + long(skipped) : LONG_MAX;
+    }
+
+    void push(const T& x) {
+        if (count < k) {
+            sample.push_back(x);
+            count++;
+            if (count == k) {
+                lower_w();
+                skip();
+            }
+            return;
+        }
+
+        if (count == next)
+            sample[rng.below(k)] = x;
+        count++;
+        if (count > next) {
+            lower_w();
+            skip();
+        }
+    }
+
+    // Pushes the items in range [first, last), without visiting those which
+    // are skipped.
+    template <typename RandomAccessIterator>
+    void push(RandomAccessIterator first, RandomAccessIterator last) {
+        while (first != last) {
+            if (count < k || count == next) {
+                push(*first++);
+                continue;
+            }
+            long skipped = std::min<long>(next - count, last - first);
+            first += skipped;
+            count += skipped;
+        }
+    }
+
+    // Merges `other`, a sample of a different stream, into this sample, such
+    // that it becomes a uniformly random sample of both streams.
+    void merge(const ReservoirSampler& other) {
+        std::vector<T> samples[] = {sample, other.sample};
+        long remaining[] = {count, other.count};
+        sample.clear();
+
+        // Draw k items from the union of both streams, each from either
+        // stream with probability proportional to its number of items not
+        // yet drawn, represented by a random item of its sample.
+        while ((long) sample.size() < k && remaining[0] + remaining[1] > 0) {
+            const uint64_t r = rng.below(remaining[0] + remaining[1]);
+            int i = r < (uint64_t) remaining[0] ? 0 : 1;
+            std::vector<T>& from = samples[i];
+            std::swap(from[rng.below(from.size())], from.back());
+            sample.push_back(from.back());
+            from.pop_back();
+            remaining[i]--;
+        }
+
+        count += other.count;
+        if (count >= k) {
+            // The kth smallest of count uniform random keys is distributed
+            // as Beta(k, count - k + 1).
+            std::gamma_distribution<double> a(k), b(count - k + 1);
+            double x = a(rng);
+            w = x / (x + b(rng));
+            skip();
+        }
+    }
+};
+
+
+// Returns a sample of k of the items in range [first, last), chosen
+// uniformly at random without replacement.
+//
+// The range is split into one chunk per thread, each thread samples its
+// chunk using its own ReservoirSampler, and the samples are merged.
+template <typename RandomAccessIterator>
+std::vector<typename std::iterator_traits<RandomAccessIterator>::value_type>
+parallel_reservoir_sample(RandomAccessIterator first,
+                          RandomAccessIterator last, long k, uint64_t seed,
+                          int threads) {
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+        Value;
+    typedef ReservoirSampler<Value> Sampler;
+
+    std::vector<Sampler> samplers;
+    for (int t = 0; t < threads; t++)
+        samplers.push_back(Sampler(k, util::Rng::stream(seed, t)()));
+
+    // Small ranges aren't worth starting threads for. The result is the same
+    // either way, as each thread has its own random stream.
+    const long n = last - first;
+    const bool parallel = n >= (1 << 16);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        RandomAccessIterator chunk_first = first + n * t / threads;
+        RandomAccessIterator chunk_last = first + n * (t + 1) / threads;
+        if (!parallel) {
+            samplers[t].push(chunk_first, chunk_last);
+            continue;
+        }
+        void (Sampler::*push)(RandomAccessIterator, RandomAccessIterator);
+        push = &Sampler::push;
+        workers.push_back(std::thread(push, &samplers[t], chunk_first,
+                                      chunk_last));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+    for (int t = 1; t < threads; t++)
+        samplers[0].merge(samplers[t]);
+
+    return samplers[0].sample;
+}
+
+
+// Maintains a sample of k items chosen at random, without replacement, from
+// a stream of weighted items, where each successive item is chosen with
+// probability proportional to its weight among the items not yet chosen
+// (Efraimidis and Spirakis' Algorithm A-ExpJ).
+//
+// Each sampled item has a random key u^(1 / weight), for u uniform in
+// [0, 1), and the sample holds the items with the k largest keys. Rather
+// than drawing a key for every item, the total weight to skip before the
+// next item enters the sample is drawn from its exponential distribution.
+// Keys are kept as logarithms, for numerical stability.
+//
+// Samples of different streams are merged by keeping the k largest keys.
+//
+// See: http://arxiv.org/abs/1012.0256
+template <typename T>
+struct WeightedReservoirSampler {
+    typedef std::pair<double, T> Entry;
+
+    struct KeyGreater {
+        bool operator()(const Entry& e1, const Entry& e2) const {
+            return e1.first > e2.first;
+        }
+    };
+
+    long k;
+    // A min-heap of (log key, item).
+    std::vector<Entry> heap;
+    // The weight still to be skipped before the next item enters the sample.
+    double skip_weight;
+    util::Rng rng;
+
+    WeightedReservoirSampler(long k, uint64_t seed)
+        : k(k), skip_weight(0), rng(seed) {}
+
+    double uniform() {
+        return 1 - rng.uniform();
+    }
+
+    void skip() {
+        skip_weight = std::log(uniform()) / heap.front().first;
+    }
+
+    // Pushes `x` with weight `weight`. Items of weight 0 are never sampled.
+    void push(const T& x, double weight) {
+        if (weight <= 0)
+            return;
+
+        if ((long) heap.size() < k) {
+            heap.push_back(Entry(std::log(uniform()) / weight, x));
+            std::push_heap(heap.begin(), heap.end(), KeyGreater());
+            if ((long) heap.size() == k)
+                skip();
+            return;
+        }
+
+        skip_weight -= weight;
+        if (skip_weight > 0)
+            return;
+
+        // The new key is conditioned on exceeding the smallest key.
+        double t = std::exp(weight * heap.front().first);
+        double key = std::log(t + (1 - t) * rng.uniform()) / weight;
+        std::pop_heap(heap.begin(), heap.end(), KeyGreater());
+        heap.back() = Entry(key, x);
+        std::push_heap(heap.begin(), heap.end(), KeyGreater());
+        skip();
+    }
+
+    void merge(const WeightedReservoirSampler& other) {
+        heap.insert(heap.end(), other.heap.begin(), other.heap.end());
+        std::make_heap(heap.begin(), heap.end(), KeyGreater());
+        while ((long) heap.size() > k) {
+            std::pop_heap(heap.begin(), heap.end(), KeyGreater());
+            heap.pop_back();
+        }
+        if ((long) heap.size() == k)
+            skip();
+    }
+
+    std::vector<T> sample() const {
+        std::vector<T> items;
+        for (size_t i = 0; i < heap.size(); i++)
+            items.push_back(heap[i].second);
+        return items;
+    }
+};
+
+
+// Returns the index of the pair {i, j}, i < j, of items in [0, n).
+int pair_index(int i, int j, int n) {
+    if (i > j)
+        std::swap(i, j);
+    return i * n - i * (i + 1) / 2 + (j - i - 1);
+}
+
+
+void test_reservoir_sampler() {
+    // Each of the 15 pairs of 6 items should be sampled equally often, using
+    // each of the sampling methods.
+    const int trials = 30000;
+    const int n = 6;
+    int items[n] = {0, 1, 2, 3, 4, 5};
+    std::vector<long> pushed(15), skipped(15), merged(15), pushed_on(15);
+
+    for (int trial = 0; trial < trials; trial++) {
+        ReservoirSampler<int> sampler(2, trial);
+        for (int i = 0; i < n; i++)
+            sampler.push(items[i]);
+        pushed[pair_index(sampler.sample[0], sampler.sample[1], n)]++;
+
+        ReservoirSampler<int> skipping(2, trial);
+        skipping.push(items, items + n);
+        skipped[pair_index(skipping.sample[0], skipping.sample[1], n)]++;
+
+        std::vector<int> sample = parallel_reservoir_sample(items, items + n,
+                                                            2, trial, 3);
+        merged[pair_index(sample[0], sample[1], n)]++;
+
+        // Pushing to a merged sample.
+        ReservoirSampler<int> left(2, trial), right(2, trial + trials);
+        left.push(items, items + 2);
+        right.push(items + 2, items + 4);
+        left.merge(right);
+        left.push(items + 4, items + n);
+        pushed_on[pair_index(left.sample[0], left.sample[1], n)]++;
+    }
+
+    assert(uniformity::TestResult(uniformity::chi_square(pushed), 14).p_value
+           > 0.001);
+    assert(uniformity::TestResult(uniformity::chi_square(skipped), 14).p_value
+           > 0.001);
+    assert(uniformity::TestResult(uniformity::chi_square(merged), 14).p_value
+           > 0.001);
+    assert(uniformity::TestResult(uniformity::chi_square(pushed_on), 14)
+           .p_value > 0.001);
+
+    // Long streams: few random numbers are drawn, and inclusion is uniform
+    // across the stream.
+    std::vector<int> stream(1000000);
+    for (size_t i = 0; i < stream.size(); i++)
+        stream[i] = i;
+    std::vector<long> deciles(10);
+    for (int trial = 0; trial < 100; trial++) {
+        ReservoirSampler<int> sampler(100, trial);
+        sampler.push(stream.begin(), stream.end());
+        assert(sampler.count == (long) stream.size());
+        assert(sampler.sample.size() == 100);
+        for (int i = 0; i < 100; i++)
+            deciles[sampler.sample[i] / 100000]++;
+
+        std::vector<int> sample = parallel_reservoir_sample(
+            stream.begin(), stream.end(), 100, trial, 4);
+        for (int i = 0; i < 100; i++)
+            deciles[sample[i] / 100000]++;
+    }
+    assert(uniformity::TestResult(uniformity::chi_square(deciles), 9).p_value
+           > 0.001);
+}
+
+
+void test_weighted_reservoir_sampler() {
+    // With weights 1, 2, 3 and 4, each pair {i, j} is sampled with
+    // probability w_i / W * w_j / (W - w_i) + w_j / W * w_i / (W - w_j).
+    const int trials = 30000;
+    const int n = 4;
+    const double weights[n] = {1, 2, 3, 4};
+    const double total = 10;
+
+    std::vector<double> expected(6);
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            expected[pair_index(i, j, n)] = trials * (
+                weights[i] / total * weights[j] / (total - weights[i])
+                + weights[j] / total * weights[i] / (total - weights[j]));
+        }
+    }
+
+    std::vector<long> pushed(6), merged(6);
+    for (int trial = 0; trial < trials; trial++) {
+        WeightedReservoirSampler<int> sampler(2, trial);
+        sampler.push(7, 0);
+        for (int i = 0; i < n; i++)
+            sampler.push(i, weights[i]);
+        std::vector<int> sample = sampler.sample();
+        pushed[pair_index(sample[0], sample[1], n)]++;
+
+        WeightedReservoirSampler<int> left(2, trial), right(2, ~trial);
+        left.push(0, weights[0]);
+        right.push(1, weights[1]);
+        right.push(2, weights[2]);
+        left.merge(right);
+        left.push(3, weights[3]);
+        sample = left.sample();
+        merged[pair_index(sample[0], sample[1], n)]++;
+    }
+
+    uniformity::TestResult pushed_result(
+        uniformity::chi_square(pushed, expected), 5);
+    uniformity::TestResult merged_result(
+        uniformity::chi_square(merged, expected), 5);
+    assert(pushed_result.p_value > 0.001);
+    assert(merged_result.p_value > 0.001);
+}
+
+
+// Algorithm R, for comparison: draws a random number for every item.
+template <typename RandomAccessIterator>
+std::vector<typename std::iterator_traits<RandomAccessIterator>::value_type>
+algorithm_r(RandomAccessIterator first, RandomAccessIterator last, long k,
+            util::Rng& rng) {
+    std::vector<typename std::iterator_traits<RandomAccessIterator>::value_type>
+        sample(first, first + k);
+    for (long i = k; i < last - first; i++) {
+        long j = rng.below(i + 1);
+        if (j < k)
+            sample[j] = first[i];
+    }
+    return sample;
+}
+
+
+void benchmark_reservoir_sampler(long n, long k) {
+    std::vector<int> stream(n);
+    for (long i = 0; i < n; i++)
+        stream[i] = i;
+
+    util::Rng rng(1);
+    util::Timer timer;
+    algorithm_r(stream.begin(), stream.end(), k, rng);
+    std::cout << "n = " << n << ", k = " << k << std::endl
+              << "  Algorithm R: " << timer.seconds() << " s" << std::endl;
+
+    timer = util::Timer();
+    ReservoirSampler<int> sampler(k, 1);
+    for (long i = 0; i < n; i++)
+        sampler.push(stream[i]);
+    std::cout << "  Algorithm L, pushing every item: " << timer.seconds()
+              << " s" << std::endl;
+
+    timer = util::Timer();
+    ReservoirSampler<int> skipping(k, 1);
+    skipping.push(stream.begin(), stream.end());
+    std::cout << "  Algorithm L, skipping items: " << timer.seconds() << " s"
+              << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        benchmark_reservoir_sampler(100000000, 1000);
+        return 0;
+    }
+
+    test_reservoir_sampler();
+    test_weighted_reservoir_sampler();
+
+    std::cout << "Tests passed." << std::endl;
+    return 0;
+}
@@ -24,44 +24,357 @@
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <iterator>
+#include <string>
 #include <vector>
 
-#include "quicksort.h"
+#include "selection.h"
 #include "util.h"
 
 
-namespace quicksort = algorithms::quicksort;
+namespace selection = algorithms::selection;
 namespace util = algorithms::util;
 
 
-// Returns the ith smallest element (indexed from 0) in range [first, last).
-template <typename RandomAccessIterator>
-typename RandomAccessIterator::value_type randomized_selection(
-        int i, RandomAccessIterator first, RandomAccessIterator last) {
-    if (last - first == 1)
-        return *first;
+template <typename Container>
+void test_select(const Container& container) {
+    Container sorted(container);
+    std::sort(sorted.begin(), sorted.end());
 
-    std::pair<RandomAccessIterator, RandomAccessIterator> pivot_range; 
-    pivot_range = quicksort::partition_section(first, last,
-                                               quicksort::Random());
+    for (size_t i = 0; i < container.size(); i += 1 + container.size() / 50) {
+        Container actual(container);
+        assert(selection::select(i, actual.begin(), actual.end())
+               == sorted[i]);
+
+        actual = container;
+        assert(selection::floyd_rivest_selection(i, actual.begin(),
+                                                 actual.end())
+               == sorted[i]);
+    }
+
+    Container actual(container);
+    selection::MedianOfMedians median_of_medians;
+    int pivot = *median_of_medians(actual.begin(), actual.end());
+    int less = std::lower_bound(sorted.begin(), sorted.end(), pivot)
+               - sorted.begin();
+    int greater = sorted.end()
+                  - std::upper_bound(sorted.begin(), sorted.end(), pivot);
+    assert(less < (int) container.size() * 7 / 10 + 5);
+    assert(greater < (int) container.size() * 7 / 10 + 5);
+}
+
+
+void test_select() {
+    const int n = 10000;
+    std::vector<std::vector<int> > inputs;
+
+    std::vector<int> rand_seq(n);
+    std::generate_n(rand_seq.begin(), n, util::randint(n));
+    inputs.push_back(rand_seq);
+
+    std::vector<int> few_unique(n);
+    std::generate_n(few_unique.begin(), n, util::randint(3));
+    inputs.push_back(few_unique);
+
+    std::vector<int> sorted(n), reversed(n), organ_pipe(n);
+    for (int i = 0; i < n; i++) {
+        sorted[i] = i;
+        reversed[i] = n - i;
+        organ_pipe[i] = std::min(i, n - i);
+    }
+    inputs.push_back(sorted);
+    inputs.push_back(reversed);
+    inputs.push_back(organ_pipe);
+    inputs.push_back(std::vector<int>(n, 7));
+    inputs.push_back(std::vector<int>(1, 7));
+
+    for (size_t i = 0; i < inputs.size(); i++)
+        test_select(inputs[i]);
+}
+
+
+void test_multi_select() {
+    const int sizes[] = {1, 100, 1000000};
+
+    for (int s = 0; s < 3; s++) {
+        const int n = sizes[s];
+        std::vector<int> input(n);
+        std::generate_n(input.begin(), n, util::randint(n));
+
+        std::vector<int> sorted(input);
+        std::sort(sorted.begin(), sorted.end());
+
+        for (int k = 1; k <= 64; k *= 4) {
+            std::vector<int> ranks(k);
+            std::generate_n(ranks.begin(), k, util::randint(n));
+            ranks.push_back(ranks[0]);
+            std::sort(ranks.begin(), ranks.end());
+
+            std::vector<int> actual(input);
+            std::vector<int> quantiles;
+            selection::multi_select(ranks.begin(), ranks.end(),
+                                    actual.begin(), actual.end(),
+                                    std::back_inserter(quantiles));
+
+            assert(quantiles.size() == ranks.size());
+            for (size_t i = 0; i < ranks.size(); i++)
+                assert(quantiles[i] == sorted[ranks[i]]);
+
+            // Force the multithreaded path regardless of available cores.
+            actual = input;
+            selection::multi_select_positions(ranks.begin(), ranks.end(),
+                                              actual.begin(), actual.begin(),
+                                              actual.end(), 8, 1000);
+            for (size_t i = 0; i < ranks.size(); i++)
+                assert(actual[ranks[i]] == sorted[ranks[i]]);
+        }
+    }
+}
 
-    int normalized_pivot_index = pivot_range.first - first;
 
-    if (normalized_pivot_index == i) {
-        return *pivot_range.first; 
+// An int that counts the comparisons made between instances.
+struct CountedInt {
+    static long comparisons;
+
+    int value;
+
+    CountedInt() {}
+    CountedInt(int value) : value(value) {}
+
+    bool operator<(const CountedInt& other) const {
+        comparisons++;
+        return value < other.value;
+    }
+
+    bool operator>(const CountedInt& other) const {
+        comparisons++;
+        return value > other.value;
+    }
+
+    bool operator<=(const CountedInt& other) const {
+        comparisons++;
+        return value <= other.value;
+    }
+
+    bool operator==(const CountedInt& other) const {
+        comparisons++;
+        return value == other.value;
+    }
+};
+
+long CountedInt::comparisons = 0;
+
+
+struct RandomizedSelection {
+    const char* name() const { return "randomized_selection"; }
+
+    template <typename RandomAccessIterator>
+    void operator()(int i, RandomAccessIterator first,
+                    RandomAccessIterator last) const {
+        selection::randomized_selection(i, first, last);
     }
-    else if (normalized_pivot_index > i) {
-        return randomized_selection(i, first, pivot_range.first);
+};
+
+
+struct Select {
+    const char* name() const { return "select"; }
+
+    template <typename RandomAccessIterator>
+    void operator()(int i, RandomAccessIterator first,
+                    RandomAccessIterator last) const {
+        selection::select(i, first, last);
     }
-    else { // normalized_pivot_index < i
-        return randomized_selection(i - normalized_pivot_index - 1,
-                                    pivot_range.first + 1,
-                                    last);
+};
+
+
+struct FloydRivestSelection {
+    const char* name() const { return "floyd_rivest_selection"; }
+
+    template <typename RandomAccessIterator>
+    void operator()(int i, RandomAccessIterator first,
+                    RandomAccessIterator last) const {
+        selection::floyd_rivest_selection(i, first, last);
+    }
+};
+
+
+struct NthElement {
+    const char* name() const { return "std::nth_element"; }
+
+    template <typename RandomAccessIterator>
+    void operator()(int i, RandomAccessIterator first,
+                    RandomAccessIterator last) const {
+        std::nth_element(first, first + i, last);
+    }
+};
+
+
+// Prints the average number of comparisons per item, and the average wall
+// time of selecting the ith smallest of n random items using `selection`.
+template <typename Selection>
+void benchmark_selection(Selection selection, int n, int i, int trials) {
+    std::vector<int> input(n);
+    std::vector<CountedInt> counted(n);
+    double seconds = 0;
+    CountedInt::comparisons = 0;
+
+    for (int trial = 0; trial < trials; trial++) {
+        std::generate_n(input.begin(), n, util::randint(n));
+
+        std::copy(input.begin(), input.end(), counted.begin());
+        selection(i, counted.begin(), counted.end());
+
+        util::Timer timer;
+        selection(i, input.begin(), input.end());
+        seconds += timer.seconds();
+    }
+
+    std::cout << "  " << selection.name() << ": "
+              << double(CountedInt::comparisons) / trials / n
+              << " comparisons/item, "
+              << seconds / trials * 1000 << " ms" << std::endl;
+}
+
+
+void benchmark_selection() {
+    const int sizes[] = {100000, 1000000, 10000000};
+    const double ranks[] = {0.5, 0.99};
+
+    for (int s = 0; s < 3; s++) {
+        for (int r = 0; r < 2; r++) {
+            const int n = sizes[s];
+            const int i = n * ranks[r];
+            const int trials = 20000000 / n;
+            std::cout << "n = " << n << ", i = " << i << std::endl;
+            benchmark_selection(RandomizedSelection(), n, i, trials);
+            benchmark_selection(Select(), n, i, trials);
+            benchmark_selection(FloydRivestSelection(), n, i, trials);
+            benchmark_selection(NthElement(), n, i, trials);
+        }
     }
 }
 
 
+// Prints the wall time of selecting the p1, p5, p25, p50, p75, p95, p99 and
+// p99.9 items of n random items, one rank at a time and with `multi_select`.
+void benchmark_multi_select(int n, int trials) {
+    const double percentiles[] = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99,
+                                  0.999};
+    const int k = sizeof percentiles / sizeof percentiles[0];
+
+    std::vector<int> ranks(k);
+    for (int i = 0; i < k; i++)
+        ranks[i] = n * percentiles[i];
+
+    std::vector<int> input(n);
+    std::vector<int> quantiles(k);
+    double select_seconds = 0;
+    double multi_select_seconds = 0;
+
+    for (int trial = 0; trial < trials; trial++) {
+        std::generate_n(input.begin(), n, util::randint(n));
+        std::vector<int> copy(input);
+
+        util::Timer select_timer;
+        for (int i = 0; i < k; i++)
+            quantiles[i] = selection::select(ranks[i], input.begin(),
+                                             input.end());
+        select_seconds += select_timer.seconds();
+
+        util::Timer multi_select_timer;
+        selection::multi_select(ranks.begin(), ranks.end(), copy.begin(),
+                                copy.end(), quantiles.begin());
+        multi_select_seconds += multi_select_timer.seconds();
+    }
+
+    std::cout << "n = " << n << ", " << k << " ranks" << std::endl
+              << "  select: " << select_seconds / trials * 1000 << " ms"
+              << std::endl
+              << "  multi_select: " << multi_select_seconds / trials * 1000
+              << " ms" << std::endl;
+}
+
+
+void test_sliding_window_rank() {
+    const int n = 2000;
+    const long windows[] = {1, 2, 5, 64, 1000};
+    const double qs[] = {0, 0.5, 0.9, 1};
+
+    std::vector<int> input(n);
+    std::generate_n(input.begin(), n, util::randint(10));
+    for (int i = n / 2; i < n; i++)
+        input[i] = i;
+
+    for (int w = 0; w < 5; w++) {
+        for (int r = 0; r < 4; r++) {
+            const long window = windows[w];
+            std::vector<int> actual;
+            selection::sliding_window_rank(input.begin(), input.end(),
+                                           window, qs[r],
+                                           std::back_inserter(actual));
+            assert((long) actual.size() == n - window + 1);
+
+            for (size_t i = 0; i < actual.size(); i++) {
+                std::vector<int> expected(input.begin() + i,
+                                          input.begin() + i + window);
+                int rank = qs[r] * (window - 1);
+                assert(actual[i] == selection::select(rank, expected.begin(),
+                                                      expected.end()));
+            }
+        }
+    }
+
+    // Partially filled windows.
+    selection::SlidingWindowRank<int> median(100, 0.5);
+    for (int i = 0; i < 10; i++) {
+        median.push(10 - i);
+        assert(median.size() == i + 1);
+        assert(median.value() == 10 - i + i / 2);
+    }
+}
+
+
+// Prints the throughput of computing the medians of sliding windows of
+// random items, using sliding_window_rank and, for comparison, selecting the
+// median of each window anew.
+void benchmark_sliding_window_rank(int n, long window) {
+    std::vector<int> input(n);
+    std::generate_n(input.begin(), n, util::randint(n));
+    std::vector<int> medians(n - window + 1);
+
+    util::Timer timer;
+    selection::sliding_window_rank(input.begin(), input.end(), window, 0.5,
+                                   medians.begin());
+    double seconds = timer.seconds();
+
+    // Selecting anew is O(window) per item, so measure fewer windows.
+    const int windows = std::min<long>(medians.size(), 20000000 / window);
+    std::vector<int> copy(window);
+    util::Timer select_timer;
+    for (int i = 0; i < windows; i++) {
+        std::copy(input.begin() + i, input.begin() + i + window,
+                  copy.begin());
+        medians[i] = selection::select(window / 2, copy.begin(), copy.end());
+    }
+    double select_seconds = select_timer.seconds();
+
+    std::cout << "n = " << n << ", window = " << window << std::endl
+              << "  sliding_window_rank: " << n / seconds / 1e6
+              << "M items/s" << std::endl
+              << "  select per window: " << windows / select_seconds / 1e6
+              << "M items/s" << std::endl;
+}
+
+
 int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        benchmark_selection();
+        benchmark_multi_select(10000000, 5);
+        benchmark_sliding_window_rank(10000000, 101);
+        benchmark_sliding_window_rank(10000000, 10001);
+        return 0;
+    }
+
     std::vector<int> A(1000);
     for (int i = 0; i < 1000; i++) {
         A.push_back(i);
@@ -72,9 +385,14 @@ int main(int argc, char** argv) {
     for (int trial = 0; trial < 1000; trial++) {
         std::random_shuffle(A.begin(), A.end());
         int i = util::randint(A.size())();
-        assert(randomized_selection(i, A.begin(), A.end()) == A_sorted[i]);
+        assert(selection::randomized_selection(i, A.begin(), A.end())
+               == A_sorted[i]);
     }
 
+    test_select();
+    test_multi_select();
+    test_sliding_window_rank();
+
     std::cout << "Tests passed." << std::endl;
     return 0;
 }
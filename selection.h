@@ -0,0 +1,473 @@
+// Copyright (c) 2012 Gregg Gajic <gregg.gajic@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Select the ith smallest element of an input array (e.g. the median) in
+// linear time.
+
+#ifndef ALGORITHMS_SELECTION_H
+#define ALGORITHMS_SELECTION_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "quicksort.h"
+#include "util.h"
+
+
+namespace algorithms {
+namespace selection {
+
+// Returns the ith smallest element (indexed from 0) in range [first, last).
+template <typename RandomAccessIterator>
+typename RandomAccessIterator::value_type randomized_selection(
+        int i, RandomAccessIterator first, RandomAccessIterator last) {
+    if (last - first == 1)
+        return *first;
+
+    std::pair<RandomAccessIterator, RandomAccessIterator> pivot_range; 
+    pivot_range = quicksort::partition_section(first, last,
+                                               quicksort::Random());
+
+    int normalized_pivot_index = pivot_range.first - first;
+
+    if (normalized_pivot_index == i) {
+        return *pivot_range.first; 
+    }
+    else if (normalized_pivot_index > i) {
+        return randomized_selection(i, first, pivot_range.first);
+    }
+    else { // normalized_pivot_index < i
+        return randomized_selection(i - normalized_pivot_index - 1,
+                                    pivot_range.first + 1,
+                                    last);
+    }
+}
+
+
+template <typename RandomAccessIterator>
+RandomAccessIterator select_position(RandomAccessIterator first,
+                                     RandomAccessIterator nth,
+                                     RandomAccessIterator last);
+
+
+struct MedianOfMedians {
+    // Given a pair of iterators, first and last, corresponding to items in
+    // range [first, last), returns an iterator to the median of the medians
+    // of groups of 5 items (Blum, Floyd, Pratt, Rivest and Tarjan).
+    //
+    // The pivot is guaranteed to be greater than and less than at least 30%
+    // of the items in [first, last), thus partitioning about it always
+    // discards a constant fraction of the input.
+    //
+    // The group medians are moved to the front of [first, last), and their
+    // median is found with `select_position`, which itself is worst-case
+    // linear.
+    template <typename RandomAccessIterator>
+    RandomAccessIterator operator()(RandomAccessIterator first,
+                                    RandomAccessIterator last) {
+        if (last - first < 5) {
+            insertion_sort(first, last);
+            return first + (last - first) / 2;
+        }
+
+        RandomAccessIterator medians_end = first;
+        for (RandomAccessIterator group = first; last - group >= 5;
+             group += 5) {
+            insertion_sort(group, group + 5);
+            std::swap(*(group + 2), *medians_end++);
+        }
+
+        return select_position(first, first + (medians_end - first) / 2,
+                               medians_end);
+    }
+
+    template <typename RandomAccessIterator>
+    static void insertion_sort(RandomAccessIterator first,
+                               RandomAccessIterator last) {
+        for (RandomAccessIterator i = first + 1; i < last; i++)
+            for (RandomAccessIterator j = i; j != first && *j < *(j - 1); j--)
+                std::swap(*j, *(j - 1));
+    }
+};
+
+
+// Rearranges the items in range [first, last) such that *nth is the item that
+// would occupy that position were [first, last) sorted, and returns nth.
+//
+// Introselect: partitions iteratively about Ninther pivots, which is fast on
+// typical inputs, while keeping count of the items scanned. Should the count
+// exceed a linear budget, as happens on adversarial inputs, the remaining
+// range is partitioned about MedianOfMedians pivots instead. Either way the
+// running time is worst-case O(n).
+template <typename RandomAccessIterator>
+RandomAccessIterator select_position(RandomAccessIterator first,
+                                     RandomAccessIterator nth,
+                                     RandomAccessIterator last) {
+    typedef std::iterator_traits<RandomAccessIterator> Traits;
+    typedef typename Traits::difference_type Difference;
+    typedef std::pair<RandomAccessIterator, RandomAccessIterator> Range;
+
+    Difference budget = 4 * (last - first);
+
+    while (last - first > 1) {
+        budget -= last - first;
+        if (budget < 0)
+            break;
+
+        Range pivot_range = quicksort::partition_section(first, last,
+                                                         quicksort::Ninther());
+        if (nth < pivot_range.first)
+            last = pivot_range.first;
+        else if (nth > pivot_range.second)
+            first = pivot_range.second + 1;
+        else
+            return nth;
+    }
+
+    while (last - first > 1) {
+        Range pivot_range = quicksort::partition_section(first, last,
+                                                         MedianOfMedians());
+        if (nth < pivot_range.first)
+            last = pivot_range.first;
+        else if (nth > pivot_range.second)
+            first = pivot_range.second + 1;
+        else
+            return nth;
+    }
+
+    return nth;
+}
+
+
+// Returns the ith smallest element (indexed from 0) in range [first, last) in
+// worst-case O(n) time. See `select_position`.
+template <typename RandomAccessIterator>
+typename std::iterator_traits<RandomAccessIterator>::value_type select(
+        int i, RandomAccessIterator first, RandomAccessIterator last) {
+    return *select_position(first, first + i, last);
+}
+
+
+// Rearranges the items in range [first, last) such that *nth is the item that
+// would occupy that position were [first, last) sorted, and returns nth.
+//
+// Floyd-Rivest: before partitioning a large range, recursively selects a
+// pivot from a small sample whose rank brackets that of nth, so that nth
+// almost always lands in the smaller side, and only a o(n) sized range
+// remains after a single partitioning pass. Makes n + min(k, n - k) + o(n)
+// comparisons on average, where k = nth - first.
+//
+// See: http://en.wikipedia.org/wiki/Floyd%E2%80%93Rivest_algorithm
+template <typename RandomAccessIterator>
+RandomAccessIterator floyd_rivest_position(RandomAccessIterator first,
+                                           RandomAccessIterator nth,
+                                           RandomAccessIterator last) {
+    typedef std::iterator_traits<RandomAccessIterator> Traits;
+    typedef typename Traits::difference_type Difference;
+    typedef typename Traits::value_type Value;
+
+    RandomAccessIterator left = first;
+    RandomAccessIterator right = last - 1;
+
+    while (right > left) {
+        if (right - left > 600) {
+            // Select from a sample of size s, positioned such that the
+            // sample's (k * s / n)th item, offset by sd standard
+            // deviations, is moved to nth.
+            double n = right - left + 1;
+            double i = nth - left + 1;
+            double z = std::log(n);
+            double s = 0.5 * std::exp(2 * z / 3);
+            double sd = 0.5 * std::sqrt(z * s * (n - s) / n)
+                        * (i - n / 2 < 0 ? -1 : 1);
+            Difference k = nth - first;
+            Difference sample_left = std::max<Difference>(
+                left - first, k - i * s / n + sd);
+            Difference sample_right = std::min<Difference>(
+                right - first, k + (n - i) * s / n + sd);
+            floyd_rivest_position(first + sample_left, nth,
+                                  first + sample_right + 1);
+        }
+
+        // Partition [left, right] about t = *nth, such that *left and
+        // *right act as sentinels for the inner scans.
+        Value t = *nth;
+        RandomAccessIterator i = left;
+        RandomAccessIterator j = right;
+        std::swap(*left, *nth);
+        if (t < *right)
+            std::swap(*right, *left);
+        while (i < j) {
+            std::swap(*i, *j);
+            i++;
+            j--;
+            while (*i < t)
+                i++;
+            while (t < *j)
+                j--;
+        }
+        if (*left == t) {
+            std::swap(*left, *j);
+        }
+        else {
+            j++;
+            std::swap(*j, *right);
+        }
+
+        // *j == t is now in its sorted position.
+        if (j <= nth)
+            left = j + 1;
+        if (nth <= j)
+            right = j - 1;
+    }
+
+    return nth;
+}
+
+
+// Returns the ith smallest element (indexed from 0) in range [first, last).
+// See `floyd_rivest_position`.
+template <typename RandomAccessIterator>
+typename std::iterator_traits<RandomAccessIterator>::value_type
+floyd_rivest_selection(int i, RandomAccessIterator first,
+                       RandomAccessIterator last) {
+    return *floyd_rivest_position(first, first + i, last);
+}
+
+
+// Rearranges the items in range [first, last) such that, for each rank r in
+// the sorted range [ranks_first, ranks_last), *(origin + r) is the item that
+// would occupy that position were [first, last) sorted. Every requested
+// position must lie within [first, last).
+//
+// The item at the middle requested rank is selected with `select_position`,
+// which partitions [first, last) about it, and the ranks to either side are
+// then handled independently within the corresponding partition. Selecting
+// k ranks therefore takes O(n log k) time rather than k * O(n).
+//
+// While fewer than `threads` threads are in use, and both partitions hold at
+// least `grain` items, the left partition is handled on a new thread.
+template <typename RanksIterator, typename RandomAccessIterator>
+void multi_select_positions(RanksIterator ranks_first,
+                            RanksIterator ranks_last,
+                            RandomAccessIterator origin,
+                            RandomAccessIterator first,
+                            RandomAccessIterator last,
+                            int threads, long grain) {
+    if (ranks_first == ranks_last)
+        return;
+
+    RanksIterator middle_rank = ranks_first + (ranks_last - ranks_first) / 2;
+    RandomAccessIterator nth = select_position(first, origin + *middle_rank,
+                                               last);
+
+    RanksIterator left_ranks_last = std::lower_bound(ranks_first,
+                                                     middle_rank,
+                                                     *middle_rank);
+    RanksIterator right_ranks_first = std::upper_bound(middle_rank,
+                                                       ranks_last,
+                                                       *middle_rank);
+
+    if (threads > 1 && nth - first >= grain && last - nth > grain) {
+        std::thread left(
+            multi_select_positions<RanksIterator, RandomAccessIterator>,
+            ranks_first, left_ranks_last, origin, first, nth,
+            threads / 2, grain);
+        multi_select_positions(right_ranks_first, ranks_last, origin,
+                               nth + 1, last, threads - threads / 2, grain);
+        left.join();
+    }
+    else {
+        multi_select_positions(ranks_first, left_ranks_last, origin,
+                               first, nth, threads, grain);
+        multi_select_positions(right_ranks_first, ranks_last, origin,
+                               nth + 1, last, threads, grain);
+    }
+}
+
+
+// Given a sorted range of ranks (indexed from 0) [ranks_first, ranks_last),
+// writes the corresponding smallest elements in range [first, last) to
+// `out`, in the same order, and returns the end of the output range.
+//
+// Rearranges [first, last). See `multi_select_positions`.
+template <typename RanksIterator, typename RandomAccessIterator,
+          typename OutputIterator>
+OutputIterator multi_select(RanksIterator ranks_first,
+                            RanksIterator ranks_last,
+                            RandomAccessIterator first,
+                            RandomAccessIterator last,
+                            OutputIterator out) {
+    const int threads = std::max(1u, std::thread::hardware_concurrency());
+    multi_select_positions(ranks_first, ranks_last, first, first, last,
+                           threads, 1 << 16);
+
+    for (RanksIterator rank = ranks_first; rank != ranks_last; rank++)
+        *out++ = *(first + *rank);
+    return out;
+}
+
+
+// Maintains the ith smallest of the last `window` items of a stream, where
+// i = floor(q * (n - 1)) for the n items currently in the window, e.g.
+// q = 0.5 maintains the (lower) median.
+//
+// The window's i + 1 smallest items are kept in a max-heap, `lower`, and the
+// rest in a min-heap, `upper`, so the ith smallest is always at the top of
+// `lower`. Both heaps are flat arrays keyed by (item, position in the
+// stream), making each key unique, so an evicted item's heap is found by
+// comparing its key with the top of `lower`. Evicted items are only removed
+// once they reach the top of their heap (lazy deletion), and a heap is
+// rebuilt without them once they outnumber its live items.
+//
+// push takes O(log window) amortized time, and value O(1) time.
+template <typename T>
+struct SlidingWindowRank {
+    typedef std::pair<T, long> Key;
+
+    long window;
+    double q;
+    long count;
+    std::vector<T> items;
+    std::vector<Key> lower;
+    std::vector<Key> upper;
+    long lower_size;
+    long upper_size;
+
+    // Requires window >= 1.
+    SlidingWindowRank(long window, double q)
+        : window(window), q(q), count(0), lower_size(0), upper_size(0) {
+        assert(window >= 1);
+        items.resize(window);
+    }
+
+    // Returns the number of items currently in the window.
+    long size() const {
+        return std::min(count, window);
+    }
+
+    // Returns the ith smallest item in the window. Requires size() > 0.
+    const T& value() const {
+        return lower.front().first;
+    }
+
+    // Appends x to the window, evicting the oldest item if the window is
+    // full.
+    void push(const T& x) {
+        if (count >= window) {
+            Key oldest(items[count % window], count - window);
+            if (lower_size > 0 && !(lower.front() < oldest))
+                lower_size--;
+            else
+                upper_size--;
+        }
+
+        Key key(x, count);
+        items[count % window] = x;
+        count++;
+        prune(lower, lower_size, std::less<Key>());
+        prune(upper, upper_size, std::greater<Key>());
+
+        if (lower_size > 0 && key < lower.front()) {
+            lower.push_back(key);
+            std::push_heap(lower.begin(), lower.end(), std::less<Key>());
+            lower_size++;
+        }
+        else {
+            upper.push_back(key);
+            std::push_heap(upper.begin(), upper.end(), std::greater<Key>());
+            upper_size++;
+        }
+
+        const long target = long(q * (size() - 1)) + 1;
+        while (lower_size > target) {
+            move_top(lower, upper, std::less<Key>(), std::greater<Key>());
+            lower_size--;
+            upper_size++;
+            prune(lower, lower_size, std::less<Key>());
+        }
+        while (lower_size < target) {
+            move_top(upper, lower, std::greater<Key>(), std::less<Key>());
+            upper_size--;
+            lower_size++;
+            prune(upper, upper_size, std::greater<Key>());
+        }
+    }
+
+    // Pops evicted items from the top of `heap`, which holds `live` items
+    // still in the window, and rebuilds it if mostly evicted items remain.
+    template <typename Compare>
+    void prune(std::vector<Key>& heap, long live, Compare compare) {
+        while (!heap.empty() && heap.front().second < count - window) {
+            std::pop_heap(heap.begin(), heap.end(), compare);
+            heap.pop_back();
+        }
+
+        if ((long) heap.size() > 2 * live + 16) {
+            long kept = 0;
+            for (size_t i = 0; i < heap.size(); i++) {
+                if (heap[i].second >= count - window)
+                    heap[kept++] = heap[i];
+            }
+            heap.resize(kept);
+            std::make_heap(heap.begin(), heap.end(), compare);
+        }
+    }
+
+    template <typename FromCompare, typename ToCompare>
+    static void move_top(std::vector<Key>& from, std::vector<Key>& to,
+                         FromCompare from_compare, ToCompare to_compare) {
+        std::pop_heap(from.begin(), from.end(), from_compare);
+        to.push_back(from.back());
+        std::push_heap(to.begin(), to.end(), to_compare);
+        from.pop_back();
+    }
+};
+
+
+// For each of the (n - window + 1) windows of `window` consecutive items in
+// range [first, last), writes the ith smallest item in the window, where
+// i = floor(q * (window - 1)), to `out`, and returns the end of the output
+// range. Requires window >= 1. See `SlidingWindowRank`.
+template <typename InputIterator, typename OutputIterator>
+OutputIterator sliding_window_rank(InputIterator first, InputIterator last,
+                                   long window, double q,
+                                   OutputIterator out) {
+    typedef typename std::iterator_traits<InputIterator>::value_type Value;
+
+    SlidingWindowRank<Value> rank(window, q);
+    for (; first != last; first++) {
+        rank.push(*first);
+        if (rank.size() == window)
+            *out++ = rank.value();
+    }
+    return out;
+}
+
+} // namespace selection
+} // namespace algorithms
+
+#endif  // ALGORITHMS_SELECTION_H
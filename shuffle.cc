@@ -21,55 +21,157 @@
 // Fischer-Yates shuffle
 
 #include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <ctime>
 #include <iostream>
-#include <map>
 #include <string>
-#include <sstream>
+#include <thread>
 #include <vector>
 
+#include "shuffle.h"
+#include "uniformity.h"
 #include "util.h"
 
 
+namespace shuffle = algorithms::shuffle;
+namespace uniformity = algorithms::uniformity;
 namespace util = algorithms::util;
 
 
-// Shuffles elements in range [first, last) in-place using the Fischer-Yates
-// algorithm.
-//
-// See: http://en.wikipedia.org/wiki/Fisher%E2%80%93Yates_shuffle
-template <typename RandomAccessIterator>
-void shuffle(RandomAccessIterator first, RandomAccessIterator last) {
-    for (RandomAccessIterator i = first; i != last; i++) {
-        int j = util::randint(last - i)();
-        std::swap(*i, *(i + j));
+// The adapters below give each shuffle the signature expected by
+// uniformity::test_permutations and uniformity::test_positions.
+
+// shuffle::shuffle using rand(), thus only usable from 1 thread.
+struct RandShuffle {
+    template <typename RandomAccessIterator>
+    void operator()(RandomAccessIterator first, RandomAccessIterator last,
+                    util::Rng& rng) const {
+        shuffle::shuffle(first, last);
     }
-}
+};
 
 
-int main(int argc, char** argv) {
-    srand(time(NULL));
+struct RngShuffle {
+    template <typename RandomAccessIterator>
+    void operator()(RandomAccessIterator first, RandomAccessIterator last,
+                    util::Rng& rng) const {
+        shuffle::shuffle(first, last, rng);
+    }
+};
+
 
-    std::map<std::string, int> distributions;
+struct BucketShuffle {
+    int threads;
+    int buckets;
 
-    int arr[] = {0, 1, 2};
+    BucketShuffle(int threads, int buckets)
+        : threads(threads), buckets(buckets) {}
 
-    for (int trial = 0; trial < 1000000; trial++) {
-        std::vector<int> L(arr, arr + (sizeof arr / sizeof arr[0]));
-        shuffle(L.begin(), L.end());
-        std::stringstream ss;
-        for (std::vector<int>::iterator it = L.begin(); it != L.end(); it++)
-            ss << *it << " ";
-        std::string dist = ss.str();
-        if (distributions.count(dist) == 0)
-            distributions[dist] = 0;
-        distributions[dist]++;
+    template <typename RandomAccessIterator>
+    void operator()(RandomAccessIterator first, RandomAccessIterator last,
+                    util::Rng& rng) const {
+        shuffle::BucketShuffle<RandomAccessIterator>(first, last, rng(),
+                                                     threads, buckets)();
     }
+};
+
+
+// Prints the result of a uniformity test, and returns whether it passed at
+// the 0.001 significance level.
+bool report(const std::string& name, const uniformity::TestResult& result) {
+    std::cout << name << ": chi-square = " << result.chi_square << " ("
+              << result.degrees_of_freedom << " d.f.), p = "
+              << result.p_value << std::endl;
+    return result.p_value > 0.001;
+}
+
+
+void test_shuffle() {
+    const int threads = std::max(1u, std::thread::hardware_concurrency());
+
+    assert(report("shuffle, permutations of 5",
+                  uniformity::test_permutations(RandShuffle(), 5, 1200000, 0,
+                                                1)));
+    assert(report("shuffle (util::Rng), permutations of 8",
+                  uniformity::test_permutations(RngShuffle(), 8, 4000000, 1,
+                                                threads)));
+    assert(report("shuffle (util::Rng), positions of 100",
+                  uniformity::test_positions(RngShuffle(), 100, 1000000, 2,
+                                             threads)));
+    assert(report("BucketShuffle, permutations of 4",
+                  uniformity::test_permutations(BucketShuffle(2, 3), 4,
+                                                240000, 3, threads)));
+    assert(report("BucketShuffle, positions of 100",
+                  uniformity::test_positions(BucketShuffle(3, 7), 100,
+                                             200000, 4, threads)));
+
+    // The 0.999 quantiles of the chi-square distribution with 3 and 23
+    // degrees of freedom are 16.266 and 49.728.
+    assert(std::fabs(uniformity::chi_square_p_value(16.266, 3) - 0.001)
+           < 1e-6);
+    assert(std::fabs(uniformity::chi_square_p_value(49.728, 23) - 0.001)
+           < 1e-6);
 
-    std::map<std::string, int>::iterator it = distributions.begin();
-    for (; it != distributions.end(); it++) {
-        std::cout << it->first << ": " << it->second << std::endl;
+    // A biased shuffle, swapping each item with any item, rather than with
+    // one that follows it, fails.
+    struct NaiveShuffle {
+        void operator()(int* first, int* last, util::Rng& rng) const {
+            for (int* i = first; i != last; i++)
+                std::swap(*i, *(first + rng.below(last - first)));
+        }
+    };
+    assert(uniformity::test_permutations(NaiveShuffle(), 4, 240000, 5,
+                                         threads).p_value < 1e-9);
+
+    // Larger inputs remain permutations, and are reproducible.
+    std::vector<int> sequence(1000000);
+    for (size_t i = 0; i < sequence.size(); i++)
+        sequence[i] = i;
+    std::vector<int> shuffled(sequence);
+    shuffle::parallel_shuffle(shuffled.begin(), shuffled.end(), 42, 3);
+    std::vector<int> again(sequence);
+    shuffle::parallel_shuffle(again.begin(), again.end(), 42, 3);
+    assert(shuffled == again);
+    assert(shuffled != sequence);
+    std::sort(shuffled.begin(), shuffled.end());
+    assert(shuffled == sequence);
+}
+
+
+void benchmark_shuffle(long n) {
+    std::vector<int> sequence(n);
+    for (long i = 0; i < n; i++)
+        sequence[i] = i;
+
+    util::Timer timer;
+    shuffle::shuffle(sequence.begin(), sequence.end());
+    std::cout << "n = " << n << std::endl
+              << "  shuffle: " << timer.seconds() << " s" << std::endl;
+
+    util::Rng rng(1);
+    timer = util::Timer();
+    shuffle::shuffle(sequence.begin(), sequence.end(), rng);
+    std::cout << "  shuffle (util::Rng): " << timer.seconds() << " s"
+              << std::endl;
+
+    timer = util::Timer();
+    shuffle::parallel_shuffle(sequence.begin(), sequence.end(), 1);
+    std::cout << "  parallel_shuffle: " << timer.seconds() << " s"
+              << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        benchmark_shuffle(100000000);
+        return 0;
     }
 
+    srand(time(NULL));
+
+    test_shuffle();
+
+    std::cout << "Tests passed." << std::endl;
     return 0;
 }
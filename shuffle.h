@@ -0,0 +1,205 @@
+// Copyright (c) 2012 Gregg Gajic <gregg.gajic@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Fischer-Yates shuffle
+
+#ifndef ALGORITHMS_SHUFFLE_H
+#define ALGORITHMS_SHUFFLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "util.h"
+
+
+namespace algorithms {
+namespace shuffle {
+
+// Shuffles elements in range [first, last) in-place using the Fischer-Yates
+// algorithm.
+//
+// See: http://en.wikipedia.org/wiki/Fisher%E2%80%93Yates_shuffle
+template <typename RandomAccessIterator>
+void shuffle(RandomAccessIterator first, RandomAccessIterator last) {
+    for (RandomAccessIterator i = first; i != last; i++) {
+        int j = util::randint(last - i)();
+        std::swap(*i, *(i + j));
+    }
+}
+
+
+// Shuffles elements in range [first, last) in-place using the Fischer-Yates
+// algorithm, drawing random numbers from `rng`.
+template <typename RandomAccessIterator>
+void shuffle(RandomAccessIterator first, RandomAccessIterator last,
+             util::Rng& rng) {
+    for (RandomAccessIterator i = first; i != last; i++) {
+        std::swap(*i, *(i + rng.below(last - i)));
+    }
+}
+
+
+// Shuffles elements in range [first, last) uniformly at random, as follows:
+//
+//  1. Each of `threads` threads scatters a contiguous chunk of the elements
+//     into `buckets` buckets, choosing each element's bucket uniformly at
+//     random.
+//  2. Each bucket, sized to fit in cache, is shuffled independently using
+//     the Fischer-Yates algorithm, and copied back to its position in
+//     [first, last), following the buckets before it.
+//
+// Every permutation is equally likely (Sandelius, 1962): the buckets'
+// contents are a uniformly random partition of the elements, and the order
+// within each bucket is uniformly random. Unlike a sequential Fischer-Yates
+// shuffle, where each swap touches a random cache line, every pass reads or
+// writes memory sequentially, or stays within cache.
+//
+// Thread t, and the shuffling of bucket b, each draw random numbers from their
+// own stream derived from `seed`, so the result is reproducible for a given
+// seed, number of threads, and number of buckets.
+//
+// See: http://arxiv.org/abs/1508.03167
+template <typename RandomAccessIterator>
+struct BucketShuffle {
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+        Value;
+
+    RandomAccessIterator first;
+    long n;
+    uint64_t seed;
+    int threads;
+    int buckets;
+    // offsets[t * buckets + b] is initially the number of elements thread t
+    // scatters into bucket b, then the position it scatters the next one to.
+    std::vector<long> offsets;
+    std::vector<long> bucket_starts;
+    std::vector<Value> scattered;
+
+    BucketShuffle(RandomAccessIterator first, RandomAccessIterator last,
+                  uint64_t seed, int threads, int buckets)
+        : first(first), n(last - first), seed(seed), threads(threads),
+          buckets(buckets), offsets(threads * buckets),
+          bucket_starts(buckets + 1), scattered(last - first) {}
+
+    void operator()() {
+        run_on_threads(&BucketShuffle::count);
+
+        long offset = 0;
+        for (int b = 0; b < buckets; b++) {
+            bucket_starts[b] = offset;
+            for (int t = 0; t < threads; t++) {
+                long count = offsets[t * buckets + b];
+                offsets[t * buckets + b] = offset;
+                offset += count;
+            }
+        }
+        bucket_starts[buckets] = n;
+
+        run_on_threads(&BucketShuffle::scatter);
+        run_on_threads(&BucketShuffle::shuffle_buckets);
+    }
+
+    void run_on_threads(void (BucketShuffle::*phase)(int)) {
+        // Small inputs aren't worth starting threads for. The result is the
+        // same either way, as each thread has its own random stream.
+        if (n < (1 << 16)) {
+            for (int t = 0; t < threads; t++)
+                (this->*phase)(t);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.push_back(std::thread(phase, this, t));
+        (this->*phase)(0);
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+    }
+
+    long chunk_start(int t) const {
+        return n * t / threads;
+    }
+
+    void count(int t) {
+        util::Rng rng = util::Rng::stream(seed, t);
+        long* counts = &offsets[t * buckets];
+        for (long i = chunk_start(t); i < chunk_start(t + 1); i++)
+            counts[rng.below(buckets)]++;
+    }
+
+    // Replays thread t's random stream from `count` to scatter its elements.
+    void scatter(int t) {
+        util::Rng rng = util::Rng::stream(seed, t);
+        long* next = &offsets[t * buckets];
+        for (long i = chunk_start(t); i < chunk_start(t + 1); i++)
+            scattered[next[rng.below(buckets)]++] = first[i];
+    }
+
+    void shuffle_buckets(int t) {
+        for (int b = t; b < buckets; b += threads) {
+            util::Rng rng = util::Rng::stream(seed, threads + b);
+            typename std::vector<Value>::iterator bucket_first, bucket_last;
+            bucket_first = scattered.begin() + bucket_starts[b];
+            bucket_last = scattered.begin() + bucket_starts[b + 1];
+            shuffle(bucket_first, bucket_last, rng);
+            std::copy(bucket_first, bucket_last, first + bucket_starts[b]);
+        }
+    }
+};
+
+
+// Shuffles elements in range [first, last) uniformly at random, using
+// `threads` threads. See `BucketShuffle`.
+template <typename RandomAccessIterator>
+void parallel_shuffle(RandomAccessIterator first, RandomAccessIterator last,
+                      uint64_t seed, int threads) {
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+        Value;
+
+    // Buckets of about 256 KiB fit in a typical L2 cache.
+    const long bucket_size = std::max(1L, long((256 << 10) / sizeof(Value)));
+    const long n = last - first;
+
+    if (n <= bucket_size) {
+        util::Rng rng(seed);
+        shuffle(first, last, rng);
+        return;
+    }
+
+    const int buckets = std::min(n / bucket_size + 1, 4096L);
+    BucketShuffle<RandomAccessIterator>(first, last, seed, threads,
+                                        buckets)();
+}
+
+
+template <typename RandomAccessIterator>
+void parallel_shuffle(RandomAccessIterator first, RandomAccessIterator last,
+                      uint64_t seed) {
+    parallel_shuffle(first, last, seed,
+                     std::max(1u, std::thread::hardware_concurrency()));
+}
+
+} // namespace shuffle
+} // namespace algorithms
+
+#endif  // ALGORITHMS_SHUFFLE_H
@@ -0,0 +1,267 @@
+// Copyright (c) 2012 Gregg Gajic <gregg.gajic@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Statistical tests of the uniformity of random permutations and samples.
+
+#ifndef ALGORITHMS_UNIFORMITY_H
+#define ALGORITHMS_UNIFORMITY_H
+
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "util.h"
+
+
+namespace algorithms {
+namespace uniformity {
+
+// Given a pair of iterators, first and last, to a permutation of the
+// integers in [0, n), where n = last - first, returns its rank in [0, n!)
+// in lexicographic order, computed from its Lehmer code.
+template <typename RandomAccessIterator>
+long permutation_rank(RandomAccessIterator first, RandomAccessIterator last) {
+    const long n = last - first;
+    long rank = 0;
+    for (long i = 0; i < n; i++) {
+        long smaller_after = 0;
+        for (long j = i + 1; j < n; j++)
+            smaller_after += first[j] < first[i];
+        rank = rank * (n - i) + smaller_after;
+    }
+    return rank;
+}
+
+
+// Returns n!.
+long factorial(int n) {
+    long result = 1;
+    for (int i = 2; i <= n; i++)
+        result *= i;
+    return result;
+}
+
+
+// Returns the Pearson chi-square statistic of `observed` counts against
+// `expected` counts.
+double chi_square(const std::vector<long>& observed,
+                  const std::vector<double>& expected) {
+    double statistic = 0;
+    for (size_t i = 0; i < observed.size(); i++) {
+        double difference = observed[i] - expected[i];
+        statistic += difference * difference / expected[i];
+    }
+    return statistic;
+}
+
+
+// Returns the Pearson chi-square statistic of `observed` counts against an
+// equal expected count for each.
+double chi_square(const std::vector<long>& observed) {
+    double total = 0;
+    for (size_t i = 0; i < observed.size(); i++)
+        total += observed[i];
+    return chi_square(observed,
+                      std::vector<double>(observed.size(),
+                                          total / observed.size()));
+}
+
+
+// Returns the regularized upper incomplete gamma function Q(a, x), using its
+// series expansion for x < a + 1, and its continued fraction otherwise.
+//
+// See: Numerical Recipes in C, 2nd edition, section 6.2.
+double regularized_gamma_q(double a, double x) {
+    const double epsilon = 1e-15;
+    if (x <= 0)
+        return 1;
+
+    const double log_prefactor = -x + a * std::log(x) - std::lgamma(a);
+
+    if (x < a + 1) {
+        double term = 1 / a;
+        double sum = term;
+        for (int n = 1; n < 1000 && term > sum * epsilon; n++) {
+            term *= x / (a + n);
+            sum += term;
+        }
+        return 1 - sum * std::exp(log_prefactor);
+    }
+
+    // Modified Lentz's method.
+    const double tiny = 1e-300;
+    double b = x + 1 - a;
+    double c = 1 / tiny;
+    double d = 1 / b;
+    double h = d;
+    for (int i = 1; i < 1000; i++) {
+        double an = -i * (i - a);
+        b += 2;
+        d = an * d + b;
+        if (std::fabs(d) < tiny)
+            d = tiny;
+        c = b + an / c;
+        if (std::fabs(c) < tiny)
+            c = tiny;
+        d = 1 / d;
+        double delta = d * c;
+        h *= delta;
+        if (std::fabs(delta - 1) < epsilon)
+            break;
+    }
+    return std::exp(log_prefactor) * h;
+}
+
+
+// Returns the probability that a chi-square statistic with the given degrees
+// of freedom is at least `statistic`.
+double chi_square_p_value(double statistic, long degrees_of_freedom) {
+    return regularized_gamma_q(degrees_of_freedom / 2.0, statistic / 2);
+}
+
+
+struct TestResult {
+    double chi_square;
+    long degrees_of_freedom;
+    double p_value;
+
+    TestResult(double chi_square, long degrees_of_freedom)
+        : chi_square(chi_square), degrees_of_freedom(degrees_of_freedom),
+          p_value(chi_square_p_value(chi_square, degrees_of_freedom)) {}
+};
+
+
+// Runs `trials` trials of `trial`, split across `threads` threads, where
+// trial(rng, counts) increments one or more of `counts`, a thread's own
+// array of `categories` counters, drawing random numbers from `rng`, a
+// thread's own stream derived from `seed`. Returns the summed counts.
+//
+// Trials that aren't thread-safe, e.g. those using rand(), must be run on
+// 1 thread.
+template <typename Trial>
+std::vector<long> count_outcomes(Trial trial, long categories, long trials,
+                                 uint64_t seed, int threads) {
+    struct Worker {
+        static void run(Trial trial, long trials, util::Rng rng,
+                        std::vector<long>* counts) {
+            for (long i = 0; i < trials; i++)
+                trial(rng, &(*counts)[0]);
+        }
+    };
+
+    std::vector<std::vector<long> > counts(threads,
+                                           std::vector<long>(categories));
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        long thread_trials = trials * (t + 1) / threads - trials * t / threads;
+        workers.push_back(std::thread(Worker::run, trial, thread_trials,
+                                      util::Rng::stream(seed, t),
+                                      &counts[t]));
+    }
+    for (int t = 0; t < threads; t++)
+        workers[t].join();
+
+    for (int t = 1; t < threads; t++) {
+        for (long i = 0; i < categories; i++)
+            counts[0][i] += counts[t][i];
+    }
+    return counts[0];
+}
+
+
+// Counts permutations of [0, n) produced by shuffle(first, last, rng) by
+// their rank.
+template <typename Shuffle>
+struct PermutationTrial {
+    Shuffle shuffle;
+    int n;
+
+    PermutationTrial(Shuffle shuffle, int n) : shuffle(shuffle), n(n) {}
+
+    void operator()(util::Rng& rng, long* counts) {
+        int permutation[20];
+        for (int i = 0; i < n; i++)
+            permutation[i] = i;
+        shuffle(permutation, permutation + n, rng);
+        counts[permutation_rank(permutation, permutation + n)]++;
+    }
+};
+
+
+// Counts, for each item i and position j, how often shuffle(first, last,
+// rng) moves item i of [0, n) to position j, in counts[i * n + j].
+template <typename Shuffle>
+struct PositionTrial {
+    Shuffle shuffle;
+    int n;
+    std::vector<int> permutation;
+
+    PositionTrial(Shuffle shuffle, int n)
+        : shuffle(shuffle), n(n), permutation(n) {}
+
+    void operator()(util::Rng& rng, long* counts) {
+        for (int i = 0; i < n; i++)
+            permutation[i] = i;
+        shuffle(permutation.begin(), permutation.end(), rng);
+        for (int j = 0; j < n; j++)
+            counts[permutation[j] * n + j]++;
+    }
+};
+
+
+// Tests whether every permutation of n items (n <= 12) is equally likely to
+// be produced by shuffle(first, last, rng), where first and last are
+// pointers to int, by counting the ranks of the permutations produced by
+// `trials` trials, split across `threads` threads.
+//
+// Trials should be at least 5 * n!, so every permutation is expected at
+// least 5 times.
+template <typename Shuffle>
+TestResult test_permutations(Shuffle shuffle, int n, long trials,
+                             uint64_t seed, int threads) {
+    const long permutations = factorial(n);
+    std::vector<long> counts = count_outcomes(
+        PermutationTrial<Shuffle>(shuffle, n), permutations, trials, seed,
+        threads);
+    return TestResult(chi_square(counts), permutations - 1);
+}
+
+
+// Tests whether each item of n items is equally likely to be moved to each
+// position by shuffle(first, last, rng), where first and last are iterators
+// of std::vector<int>, by counting the final positions of the items over
+// `trials` trials, split across `threads` threads.
+//
+// Unlike test_permutations, this only tests the marginal distributions of
+// the positions, but works for larger n.
+template <typename Shuffle>
+TestResult test_positions(Shuffle shuffle, int n, long trials, uint64_t seed,
+                          int threads) {
+    std::vector<long> counts = count_outcomes(
+        PositionTrial<Shuffle>(shuffle, n), long(n) * n, trials, seed,
+        threads);
+    return TestResult(chi_square(counts), long(n - 1) * (n - 1));
+}
+
+} // namespace uniformity
+} // namespace algorithms
+
+#endif  // ALGORITHMS_UNIFORMITY_H
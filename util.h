@@ -22,6 +22,8 @@
 #define ALGORITHMS_UTIL_H
 
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -72,6 +74,77 @@ struct randint {
 };
 
 
+// A small, fast pseudo-random number generator (SplitMix64).
+//
+// Unlike `randint`, which shares the global state of rand(), each instance
+// owns its state, so instances may be used concurrently from different
+// threads, and a given seed always reproduces the same sequence.
+//
+// See: http://xoshiro.di.unimi.it/splitmix64.c
+struct Rng {
+    // Rng may be used with the distributions in <random>.
+    typedef uint64_t result_type;
+
+    uint64_t state;
+
+    explicit Rng(uint64_t seed) : state(seed) {}
+
+    // Returns a generator for the ith of many streams derived from `seed`,
+    // e.g. one per thread.
+    static Rng stream(uint64_t seed, uint64_t i) {
+        Rng mixer(seed ^ (i * 0xd1b54a32d192ed03ULL));
+        return Rng(mixer());
+    }
+
+    // Returns a 64-bit integer chosen uniformly at random.
+    uint64_t operator()() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    static uint64_t min() {
+        return 0;
+    }
+
+    static uint64_t max() {
+        return UINT64_MAX;
+    }
+
+    // Returns an integer in range [0, n) chosen uniformly at random.
+    uint64_t below(uint64_t n) {
+        // Reject the lowest (2^64 mod n) values, leaving a multiple of n.
+        uint64_t threshold = -n % n;
+        uint64_t r;
+        do {
+            r = (*this)();
+        } while (r < threshold);
+        return r % n;
+    }
+
+    // Returns a real number in range [0, 1) chosen uniformly at random.
+    double uniform() {
+        return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+
+// Measures elapsed wall-clock time, for use in benchmarks.
+struct Timer {
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point start;
+
+    Timer() : start(Clock::now()) {}
+
+    // Returns the number of seconds elapsed since construction.
+    double seconds() const {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+};
+
+
 // trim from start
 static inline std::string& ltrim(std::string& s) {
     s.erase(s.begin(),